@@ -0,0 +1,97 @@
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <print>
+#include <vector>
+
+#include "tpl.hpp"
+
+// Counts the calls to the global allocation functions while `counting` is set.
+static std::atomic<bool> counting{false};
+static std::atomic<std::size_t> mallocs{0};
+
+static auto counted_alloc(std::size_t size, std::size_t align) -> void* {
+    if (counting.load(std::memory_order_relaxed)) mallocs.fetch_add(1, std::memory_order_relaxed);
+    if (align <= alignof(std::max_align_t)) {
+        if (auto p = std::malloc(size ? size : 1)) return p;
+    } else {
+        if (auto p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return counted_alloc(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return counted_alloc(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t a) { return counted_alloc(size, static_cast<std::size_t>(a)); }
+void* operator new[](std::size_t size, std::align_val_t a) { return counted_alloc(size, static_cast<std::size_t>(a)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+constexpr std::size_t N = 100'000;
+
+template <typename Fn>
+auto measure(char const* name, Fn&& fn) {
+    mallocs = 0;
+    counting = true;
+    fn();
+    counting = false;
+    std::println("{:<36}: {:>8} mallocs, {:.4f} per task", name, mallocs.load(), double(mallocs.load()) / N);
+}
+
+int main() {
+    // A 48 byte capture; bigger than the small buffer of `std::function` but
+    // smaller than the inline storage of `InplaceFunction`.
+    std::array<std::size_t, 6> payload{ 1, 2, 3, 4, 5, 6 };
+    std::atomic<std::size_t> sum{0};
+
+    {
+        std::vector<std::function<void()>> fns;
+        fns.reserve(N);
+        measure("std::function (baseline)", [&] {
+            for (auto i = 0ul; i < N; ++i) {
+                fns.emplace_back([payload, &sum] { sum += payload[0]; });
+            }
+        });
+    }
+
+    tpl::Scheduler s;
+    // Spawns the workers and sizes the internal buffers outside the measurement.
+    auto warm_up = [&] {
+        s.reset();
+        s.reserve(N);
+        for (auto i = 0ul; i < N; ++i) {
+            s.add_task([payload, &sum] { sum += payload[0]; });
+            s.queue_work([payload, &sum] noexcept { sum += payload[0]; });
+        }
+        (void)s.run();
+        s.reset();
+    };
+    warm_up();
+
+    s.reserve(N);
+    measure("Scheduler::add_task", [&] {
+        for (auto i = 0ul; i < N; ++i) {
+            s.add_task([payload, &sum] { sum += payload[0]; });
+        }
+    });
+    measure("Scheduler::run", [&] { (void)s.run(); });
+
+    warm_up();
+    measure("Scheduler::queue_work + run", [&] {
+        for (auto i = 0ul; i < N; ++i) {
+            s.queue_work([payload, &sum] noexcept { sum += payload[0]; });
+        }
+        (void)s.run();
+    });
+
+    std::println("sum: {}", sum.load());
+}
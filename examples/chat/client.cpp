@@ -12,7 +12,13 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <string>
+#include <string_view>
 
 #include "tpl.hpp"
 
@@ -33,12 +39,12 @@ struct Connection {
     sockaddr_storage addr{};
 };
 
-struct Message {
-    Connection c;
-    std::string message;
-};
-
-int main() {
+// Without arguments, it's an interactive client. With a count, it sends that many
+// lines as fast as the socket takes them and reports how long it took to receive
+// all of them back from the server; run it alone against `server -q` to measure
+// the round-trip throughput.
+int main(int argc, char** argv) {
+    auto count = argc > 1 ? std::stoul(argv[1]) : 0ul;
     int sockfd;
     addrinfo *servinfo{nullptr};
 
@@ -76,27 +82,105 @@ int main() {
         exit(3);
     }
 
+    if (fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK) == -1) {
+        perror("[Client]: fcntl: ");
+        exit(4);
+    }
+
     Scheduler s;
 
-    auto res = s
-        | [&sockfd](TaskToken& t) {
-            std::string line;
-            std::getline(std::cin, line);
-            auto n = write(sockfd, line.data(), line.size());
-            if (n == 0) return; // connection is closed
+    // Parks the task until the socket is ready; false if it must give up.
+    auto wait = [](TaskToken& t, int fd, bool readable) {
+        auto res = readable ? t.wait_readable(fd) : t.wait_writable(fd);
+        if (!res) std::println(stderr, "[Client]: {}", to_string(res.error()));
+        return res.has_value();
+    };
+
+    if (count == 0) {
+        // stdin stays blocking, so it's only read once the reactor says it's ready.
+        // A regular file can't be watched, but it's always ready anyway.
+        auto stdin_ready = false;
+        s.add_task([&stdin_ready, sockfd](TaskToken& t) {
+            if (!stdin_ready) {
+                stdin_ready = true;
+                if (!t.wait_readable(STDIN_FILENO)) t.schedule();
+                return;
+            }
+            stdin_ready = false;
+            char buff[256];
+            auto n = read(STDIN_FILENO, buff, sizeof(buff));
+            if (n <= 0) {
+                shutdown(sockfd, SHUT_WR);
+                return;
+            }
+            // Small writes; if the socket is full, the line is dropped.
+            (void)send(sockfd, buff, static_cast<std::size_t>(n), MSG_NOSIGNAL);
             t.schedule();
+        });
+        s.add_task([&wait, sockfd](TaskToken& t) {
+            char buff[256];
+            auto n = read(sockfd, buff, sizeof(buff));
+            if (n > 0) {
+                std::println("Message: {}", std::string_view(buff, static_cast<std::size_t>(n)));
+                t.schedule();
+            } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                wait(t, sockfd, true);
+            }
+        });
+        (void)s.run();
+        close(sockfd);
+        return 0;
+    }
+
+    auto sent = 0ul;
+    auto received = std::atomic<std::size_t>{0};
+    auto line = std::string{};
+    auto offset = 0ul;
+    auto start = std::chrono::steady_clock::now();
+
+    s.add_task([&, sockfd](TaskToken& t) {
+        while (sent < count || offset < line.size()) {
+            if (offset == line.size()) {
+                line = std::format("ping {}\n", sent++);
+                offset = 0;
+            }
+            auto n = send(sockfd, line.data() + offset, line.size() - offset, MSG_NOSIGNAL);
+            if (n > 0) {
+                offset += static_cast<std::size_t>(n);
+            } else if (n == -1 && errno == EINTR) {
+                continue;
+            } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                wait(t, sockfd, false);
+                return;
+            } else {
+                perror("[Client]: send");
+                return;
+            }
         }
-        | [&sockfd](TaskToken& t) {
-            char buff[256] = {0};
-            auto n = read(sockfd, buff, sizeof(buff) - 1);
-            if (n == 0) return;
-            buff[n] = 0;
-            std::println("Message: {}", buff);
-            t.schedule();
+    });
+    s.add_task([&, sockfd](TaskToken& t) {
+        char buff[4096];
+        while (received.load(std::memory_order_relaxed) < count) {
+            auto n = read(sockfd, buff, sizeof(buff));
+            if (n > 0) {
+                received.fetch_add(static_cast<std::size_t>(std::count(buff, buff + n, '\n')), std::memory_order_relaxed);
+            } else if (n == -1 && errno == EINTR) {
+                continue;
+            } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                wait(t, sockfd, true);
+                return;
+            } else {
+                std::println(stderr, "[Client]: connection closed");
+                return;
+            }
         }
-        ;
-
-    res.run();
-
+    });
+    (void)s.run();
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::println(
+        "[Client]: {} of {} messages in {:.3f}s ({:.0f} msg/s)",
+        received.load(), count, elapsed, static_cast<double>(received.load()) / elapsed
+    );
     close(sockfd);
 }
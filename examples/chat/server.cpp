@@ -11,8 +11,11 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <sys/wait.h>
-#include <vector>
+#include <array>
+#include <atomic>
+#include <string_view>
 
 #include "tpl.hpp"
 
@@ -33,12 +36,14 @@ struct Connection {
     sockaddr_storage addr{};
 };
 
-struct Message {
-    Connection c;
-    std::string message;
-};
+static constexpr std::size_t max_connections = 10;
 
-int main() {
+// Every connection is served by a task that reads until `EAGAIN` and then parks on
+// the scheduler's reactor, so the workers only run when there is something to do.
+// Messages are broadcast to every connection without blocking; a client that does
+// not keep up loses them. Run with `-q` to stop logging every message.
+int main(int argc, char** argv) {
+    auto quiet = argc > 1 && std::string_view(argv[1]) == "-q";
     int sockfd;
     addrinfo *servinfo{nullptr};
 
@@ -85,8 +90,12 @@ int main() {
         exit(3);
     }
 
-    // MAX 10 connection
-    if (listen(sockfd, 10) == -1) {
+    if (fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK) == -1) {
+        perror("[Server]: fcntl: ");
+        exit(4);
+    }
+
+    if (listen(sockfd, max_connections) == -1) {
         perror("listen");
         exit(4);
     }
@@ -94,94 +103,114 @@ int main() {
     std::println("[Server]: waiting for connections...\n");
 
     Scheduler s;
-    bounded_channel_t<Message*, 64> ch;
-
-
-    // this is not thread-safe
-    auto conns = std::vector<Connection>{};
-    conns.reserve(10);
 
-    auto read_task = [&ch, &conns](TaskToken& t, std::size_t id) {
-        if (ch.is_closed()) return;
-        if (conns.size() <= id) {
-            ThisThread::sleep_for(std::chrono::milliseconds(10));
-            t.schedule();
-            return;
-        }
-        auto c = conns[id];
-        char buff[256] = {};
-        auto n = read(c.fd, buff, sizeof(buff) - 1);
-        if (n != 0) {
-            buff[n] = 0;
-            auto tmp = new Message{
-                .c = c,
-                .message = std::string(buff)
-            };
-            std::println("[Server]: Client({}) sent '{}'", id, tmp->message);
-            auto res = ch.send(tmp);
-            if (!res) {
-                if (res.error() == ChannelError::closed) return;
+    // INFO: Descriptor of every connection or -1 if the slot is free.
+    auto conns = std::array<std::atomic<int>, max_connections>{};
+    for (auto& c: conns) c.store(-1);
+    auto messages = std::atomic<std::size_t>{0};
+
+    // NOTE: A connection closed in the meantime may have its descriptor reused by
+    // the next one; that's fine for a chat.
+    auto broadcast = [&conns](char const* data, std::size_t size) {
+        for (auto& c: conns) {
+            auto fd = c.load(std::memory_order_acquire);
+            if (fd == -1) continue;
+            auto offset = 0ul;
+            while (offset < size) {
+                auto n = send(fd, data + offset, size - offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (n > 0) {
+                    offset += static_cast<std::size_t>(n);
+                } else if (n == -1 && errno == EINTR) {
+                    continue;
+                } else {
+                    break;
+                }
             }
-            t.schedule();
-        } else {
-            // connection might be closed
         }
     };
 
-    auto write_task = [&ch, &conns](TaskToken& t) {
-        if (ch.is_closed() && ch.empty()) return;
-        auto tmp = ch.receive();
-        if (!tmp) {
+    auto read_task = [&conns, &broadcast, &messages, quiet](TaskToken& t, std::size_t id) {
+        auto fd = conns[id].load(std::memory_order_acquire);
+        if (fd == -1) {
+            t.schedule_after(std::chrono::milliseconds(10));
             return;
         }
-        auto msg = tmp.value();
-
-        auto size = conns.size();
-        for (auto i = 0ul; i < size; ++i) {
-            auto nc = conns[i];
-            write(nc.fd, msg->message.data(), msg->message.size());
+        char buff[4096];
+        // Bounded so one busy client can't hold on to the worker.
+        for (auto i = 0; i < 16; ++i) {
+            auto n = read(fd, buff, sizeof(buff));
+            if (n > 0) {
+                messages.fetch_add(1, std::memory_order_relaxed);
+                if (!quiet) {
+                    std::println("[Server]: Client({}) sent '{}'", id, std::string_view(buff, static_cast<std::size_t>(n)));
+                }
+                broadcast(buff, static_cast<std::size_t>(n));
+                continue;
+            }
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (auto res = t.wait_readable(fd); !res) {
+                    std::println(stderr, "[Server]: {}", to_string(res.error()));
+                }
+                return;
+            }
+            // Closed by the client or failed; the slot is free for the next one.
+            std::println("[Server]: Client({}) disconnected", id);
+            conns[id].store(-1, std::memory_order_release);
+            close(fd);
+            t.schedule_after(std::chrono::milliseconds(10));
+            return;
         }
-
-        delete msg;
-
         t.schedule();
     };
 
-    auto ts = s
-        | [&ch, &conns, sockfd](TaskToken& t) {
-            if (ch.is_closed()) return;
-            if (conns.size() == 10) return;
+    s.add_task([&conns, sockfd](TaskToken& t) {
+        while (true) {
             auto c = Connection();
             socklen_t sin_size = sizeof(c.addr);
-            auto new_fd = accept(sockfd, reinterpret_cast<struct sockaddr *>(&c.addr), &sin_size);
-            c.fd = new_fd;
-            if (new_fd == -1) {
+            c.fd = accept4(sockfd, reinterpret_cast<struct sockaddr *>(&c.addr), &sin_size, SOCK_NONBLOCK);
+            if (c.fd == -1) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    if (auto res = t.wait_readable(sockfd); !res) {
+                        std::println(stderr, "[Server]: {}", to_string(res.error()));
+                    }
+                    return;
+                }
                 perror("[Server]: Accept: ");
-                t.schedule();
+                t.schedule_after(std::chrono::milliseconds(10));
                 return;
             }
+
+            auto slot = conns.end();
+            for (auto it = conns.begin(); it != conns.end(); ++it) {
+                auto expected = -1;
+                if (it->compare_exchange_strong(expected, c.fd, std::memory_order_acq_rel)) {
+                    slot = it;
+                    break;
+                }
+            }
+            if (slot == conns.end()) {
+                std::println("[Server]: Too many connections");
+                close(c.fd);
+                continue;
+            }
+
             char buff[INET6_ADDRSTRLEN];
             inet_ntop(c.addr.ss_family, get_in_addr(reinterpret_cast<struct sockaddr *>(&c.addr)), buff, sizeof(buff));
             std::println("[Server]: Connected to '{}'", buff);
-            conns.push_back(c);
-            t.schedule();
-        } | TaskGroup { // Task per connection
-            [&read_task](auto& t) { return read_task(t, 0); },
-            [&read_task](auto& t) { return read_task(t, 1); },
-            [&read_task](auto& t) { return read_task(t, 2); },
-            [&read_task](auto& t) { return read_task(t, 3); },
-            [&read_task](auto& t) { return read_task(t, 4); },
-            [&read_task](auto& t) { return read_task(t, 5); },
-            [&read_task](auto& t) { return read_task(t, 6); },
-            [&read_task](auto& t) { return read_task(t, 7); },
-            [&read_task](auto& t) { return read_task(t, 8); },
-            [&read_task](auto& t) { return read_task(t, 9); },
-            [&read_task](auto& t) { return read_task(t, 10); },
-        } | write_task;
-    ts.run();
-
-    for (auto c: conns) {
-        close(c.fd);
+        }
+    });
+
+    // Task per connection slot
+    for (auto i = 0ul; i < max_connections; ++i) {
+        s.add_task([&read_task, i](TaskToken& t) { read_task(t, i); });
+    }
+    (void)s.run();
+
+    std::println("[Server]: {} messages", messages.load());
+    for (auto& c: conns) {
+        if (auto fd = c.load(); fd != -1) close(fd);
     }
 
     close(sockfd);
@@ -28,8 +28,8 @@ int main() {
             auto args = t.all_of<std::pair<int, std::size_t>>();
             if (args.size() != 3) throw std::runtime_error("Args must be 3");
 
-            for (auto i = 0ul; i < args.size(); ++i) {
-                auto [a, b] = args[i].take();
+            for (auto arg: args) {
+                auto [a, b] = arg.take();
                 std::println("Pair[{}]: {}", a, b);
             } 
         } + ErrorHandler([](std::exception const& e) {
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tpl.hpp"
+
+using namespace tpl;
+
+constexpr std::size_t SLOTS = 1 << 16;
+constexpr std::size_t ROUNDS = 16;
+
+// Each producer owns every `nthreads`-th slot so neighbouring slots are written
+// by different threads; after a barrier every thread consumes the slots of its
+// neighbour.
+template <typename T, typename Make>
+auto bench(char const* name, std::size_t nthreads, Make&& make) {
+    BlockAllocator alloc;
+    ValueStore store(&alloc);
+    store.resize(SLOTS);
+
+    std::barrier sync(static_cast<std::ptrdiff_t>(nthreads));
+    std::atomic<std::size_t> checksum{0};
+    auto worker = [&](std::size_t k) {
+        std::size_t sum{};
+        for (auto r = 0ul; r < ROUNDS; ++r) {
+            for (auto i = k; i < SLOTS; i += nthreads) {
+                store.put(TaskId(i), make(i));
+            }
+            sync.arrive_and_wait();
+            auto n = (k + 1) % nthreads;
+            for (auto i = n; i < SLOTS; i += nthreads) {
+                auto v = store.consume<T>(TaskId(i));
+                if (v) {
+                    [[maybe_unused]] auto val = v->take();
+                    ++sum;
+                }
+                store.remove(TaskId(i));
+            }
+            sync.arrive_and_wait();
+        }
+        checksum.fetch_add(sum);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (auto k = 0ul; k < nthreads; ++k) threads.emplace_back(worker, k);
+    for (auto& t: threads) t.join();
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    auto ops = double(SLOTS * ROUNDS);
+    std::println("{:<28} threads={:<3} {:>8.2f} ns/put+consume (checksum: {})", name, nthreads, elapsed / ops, checksum.load());
+}
+
+int main() {
+    auto max_threads = std::max<std::size_t>(2, std::thread::hardware_concurrency());
+    for (auto n = 2ul; n <= max_threads; n *= 2) {
+        bench<std::size_t>("size_t (inline)", n, [](std::size_t i) { return i; });
+        bench<std::string>("std::string (inline)", n, [](std::size_t i) { return std::string(i % 64, 'x'); });
+        bench<std::array<std::size_t, 32>>("array<size_t, 32> (allocated)", n, [](std::size_t i) {
+            std::array<std::size_t, 32> a{};
+            a[0] = i;
+            return a;
+        });
+    }
+}
@@ -63,7 +63,7 @@ namespace tpl::par {
 
             auto reduce_task = s.add_task([acc, &fn](TaskToken& t) {
                 auto args = t.all_of<Acc>();
-                return std::accumulate(args.begin(), args.end(), acc, [&fn](Acc acc, auto& v) {
+                return std::accumulate(args.begin(), args.end(), acc, [&fn](Acc acc, auto&& v) {
                     if constexpr (std::is_invocable_v<Fn, Acc, Acc, TaskToken*>) {
                         return std::invoke(fn, acc, v.ref(), nullptr);
                     } else if constexpr (std::is_invocable_v<Fn, TaskToken*, Acc, Acc>) {
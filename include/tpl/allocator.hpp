@@ -65,9 +65,21 @@ namespace tpl {
 
         template <typename T>
         TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto alloc(size_type number_of_objects = 1, size_type alignment = alignof(T)) noexcept -> T* {
+            return alloc_with_refs<T>(number_of_objects, alignment, 1);
+        }
+
+        // INFO: Allocates the objects with a single bump, but every one of them counts
+        // as its own allocation, so they can be passed to `dealloc` one at a time.
+        template <typename T>
+        TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto alloc_n(size_type number_of_objects, size_type alignment = alignof(T)) noexcept -> T* {
+            return alloc_with_refs<T>(number_of_objects, alignment, number_of_objects);
+        }
+
+        template <typename T>
+        TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto alloc_with_refs(size_type number_of_objects, size_type alignment, size_type refs) noexcept -> T* {
             auto const size_bytes = static_cast<size_type>(sizeof(T) * number_of_objects);
             while (true) {
-                auto m = try_alloc(size_bytes, alignment);
+                auto m = try_alloc(size_bytes, alignment, refs);
                 if (std::get<0>(m) == nullptr) return nullptr;
                 if (m_ref.compare_exchange(std::get<2>(m), std::get<1>(m), std::memory_order_release, std::memory_order_relaxed)) {
                     auto ptr = std::get<0>(m);
@@ -176,7 +188,8 @@ namespace tpl {
 
         TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto try_alloc(
             size_type size_bytes,
-            size_type alignment
+            size_type alignment,
+            size_type refs = 1
         ) const noexcept -> std::tuple<std::byte*, ref_t, ref_t> {
             assert(m_size != 0);
             assert(alignment > 0);
@@ -192,7 +205,7 @@ namespace tpl {
             if (!in_range(base_ptr + size_bytes)) return { nullptr, ref_t(), r };
             auto offset = static_cast<unsigned>((base_ptr + size_bytes) - (m_mem + start));
 
-            return { base_ptr, ref_t{ .first = r.first + 1, .second = r.second + offset }, r };
+            return { base_ptr, ref_t{ .first = r.first + refs, .second = r.second + offset }, r };
         }
 
         template <typename T>
@@ -300,15 +313,25 @@ namespace tpl {
 
         template <typename T>
         TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto alloc(size_type number_of_objects = 1, size_type alignment = alignof(T)) noexcept -> T* {
+            return alloc_with_refs<T>(number_of_objects, alignment, 1);
+        }
 
+        // INFO: See `BumpAllocator::alloc_n`.
+        template <typename T>
+        TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto alloc_n(size_type number_of_objects, size_type alignment = alignof(T)) noexcept -> T* {
+            return alloc_with_refs<T>(number_of_objects, alignment, number_of_objects);
+        }
+
+        template <typename T>
+        TPL_ATOMIC_FUNC_ATTR [[nodiscard]] auto alloc_with_refs(size_type number_of_objects, size_type alignment, size_type refs) noexcept -> T* {
             while (true) {
                 {
-                    auto ptr = try_alloc<T>(number_of_objects, alignment);
+                    auto ptr = try_alloc<T>(number_of_objects, alignment, refs);
                     if (ptr) return ptr;
                 }
 
                 auto node = new Node{ .bm = BumpAllocator(std::max<size_type>(number_of_objects * sizeof(T) * 2, default_size)), .next = nullptr };
-                auto ptr = node->bm.alloc<T>(number_of_objects, alignment);
+                auto ptr = node->bm.alloc_with_refs<T>(number_of_objects, alignment, refs);
 
                 auto root = m_root.load(std::memory_order_acquire);
                 node->next.store(root, std::memory_order_relaxed);
@@ -487,10 +510,10 @@ namespace tpl {
         }
 
         template <typename T>
-        [[nodiscard]] auto try_alloc(size_type number_of_objects = 1, size_type alignment = alignof(T)) noexcept -> T* {
+        [[nodiscard]] auto try_alloc(size_type number_of_objects = 1, size_type alignment = alignof(T), size_type refs = 1) noexcept -> T* {
             auto root = m_root.load(std::memory_order_relaxed);
             while (root) {
-                auto ptr = root->bm.alloc<T>(number_of_objects, alignment);
+                auto ptr = root->bm.alloc_with_refs<T>(number_of_objects, alignment, refs);
                 if (ptr) return ptr;
                 root = root->next.load(std::memory_order_relaxed);
             }
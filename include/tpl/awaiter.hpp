@@ -1,17 +1,242 @@
 #ifndef TPL_AMT_AWAITER_HPP
 #define TPL_AMT_AWAITER_HPP
 
-#include "waiter.hpp"
+#include "inplace_function.hpp"
+#include "worker_pool.hpp"
+#include <atomic>
 #include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <variant>
 
 namespace tpl {
 
+    struct Scheduler;
+
+    template <typename T>
+    struct Awaiter;
+
+    namespace internal {
+        // INFO: State shared by an `Awaiter` and the work item that fills it. It's
+        // signalled with a single atomic and recycled through a free list of the
+        // thread that drops the last reference, so a warm `awaitable_queue_work`
+        // does not allocate.
+        template <typename T>
+        struct AwaiterState {
+            using value_type = std::conditional_t<std::is_void_v<T>, void*, T>;
+            // INFO: Free states kept per thread; the rest are deleted.
+            static constexpr std::size_t max_cached = 64;
+
+            enum: std::uint32_t {
+                pending,
+                // INFO: A waiter has claimed the state and is setting `continuation`.
+                arming,
+                // INFO: `continuation` is set and owned by `finish`.
+                parked,
+                finished
+            };
+
+            static auto make() -> AwaiterState* {
+                auto& cache = s_cache;
+                if (auto s = cache.head) {
+                    cache.head = s->next;
+                    --cache.size;
+                    s->refs.store(1, std::memory_order_relaxed);
+                    return s;
+                }
+                return new AwaiterState();
+            }
+
+            auto retain() noexcept -> void {
+                refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            auto release() noexcept -> void {
+                if (refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+                value.reset();
+                continuation = {};
+                state.store(pending, std::memory_order_relaxed);
+                auto& cache = s_cache;
+                if (cache.size >= max_cached) {
+                    delete this;
+                    return;
+                }
+                next = cache.head;
+                cache.head = this;
+                ++cache.size;
+            }
+
+            auto is_finished() const noexcept -> bool {
+                return state.load(std::memory_order_acquire) == finished;
+            }
+
+            // INFO: Hands `fn` over to `finish`. It returns false and leaves `fn` to the
+            // caller if it has already finished or someone else is waiting on it.
+            // The slot is claimed before `continuation` is written, so a second waiter
+            // never touches the continuation of the first one.
+            auto try_park(InplaceFunction<void()>& fn) noexcept -> bool {
+                auto expected = std::uint32_t{pending};
+                if (!state.compare_exchange_strong(expected, arming, std::memory_order_acquire)) return false;
+                continuation = std::move(fn);
+                expected = arming;
+                if (state.compare_exchange_strong(expected, parked, std::memory_order_acq_rel)) return true;
+                // NOTE: Finished while it was arming; `finish` left the continuation here.
+                fn = std::move(continuation);
+                return false;
+            }
+
+            // INFO: Moves the value out; only valid once it's finished and only once.
+            auto take() noexcept (std::is_nothrow_move_constructible_v<value_type>) -> value_type {
+                if constexpr (std::is_void_v<T>) {
+                    return nullptr;
+                } else {
+                    assert(value.has_value() && "the value has already been taken");
+                    auto val = std::move(*value);
+                    value.reset();
+                    return val;
+                }
+            }
+
+            // INFO: Blocks the calling thread until it's finished.
+            auto wait() const noexcept -> void {
+                auto s = state.load(std::memory_order_acquire);
+                while (s != finished) {
+                    state.wait(s, std::memory_order_acquire);
+                    s = state.load(std::memory_order_acquire);
+                }
+            }
+
+            auto notify_value(value_type val)
+                noexcept (std::is_nothrow_move_constructible_v<value_type>)
+                requires (!std::is_void_v<T>)
+            {
+                value.emplace(std::move(val));
+                finish();
+            }
+
+            auto notify_value() noexcept -> void requires (std::is_void_v<T>) {
+                finish();
+            }
+
+            std::atomic<std::uint32_t> state{pending};
+            std::atomic<std::uint32_t> refs{1};
+            std::optional<value_type> value;
+            InplaceFunction<void()> continuation{};
+
+        private:
+            auto finish() noexcept -> void {
+                if (state.exchange(finished, std::memory_order_acq_rel) == parked) {
+                    auto fn = std::move(continuation);
+                    fn();
+                }
+                state.notify_all();
+            }
+
+            struct Cache {
+                AwaiterState* head{nullptr};
+                std::size_t size{0};
+
+                ~Cache() {
+                    while (head) delete std::exchange(head, head->next);
+                }
+            };
+
+            AwaiterState* next{nullptr};
+            static inline thread_local Cache s_cache{};
+        };
+
+        // INFO: Intrusive reference to an `AwaiterState`. It's move-only so an `Awaiter`
+        // can't be copied into a second waiter; the producer gets its own reference
+        // through `share`.
+        template <typename T>
+        struct AwaiterRef {
+            using state_t = AwaiterState<T>;
+
+            AwaiterRef()
+                : m_state(state_t::make())
+            {}
+            AwaiterRef(AwaiterRef const&) = delete;
+            AwaiterRef(AwaiterRef && other) noexcept
+                : m_state(std::exchange(other.m_state, nullptr))
+            {}
+            AwaiterRef& operator=(AwaiterRef const&) = delete;
+            AwaiterRef& operator=(AwaiterRef && other) noexcept {
+                if (this == &other) return *this;
+                if (m_state) m_state->release();
+                m_state = std::exchange(other.m_state, nullptr);
+                return *this;
+            }
+            ~AwaiterRef() {
+                if (m_state) m_state->release();
+            }
+
+            auto share() const noexcept -> AwaiterRef {
+                if (m_state) m_state->retain();
+                return AwaiterRef(m_state);
+            }
+
+            auto operator->() const noexcept -> state_t* { return m_state; }
+            auto get() const noexcept -> state_t* { return m_state; }
+        private:
+            explicit AwaiterRef(state_t* s) noexcept
+                : m_state(s)
+            {}
+        private:
+            state_t* m_state;
+        };
+
+        struct AwaiterOps;
+
+        template <typename T, typename Fn>
+        struct then_result {
+            using type = std::invoke_result_t<Fn, T&&>;
+        };
+
+        template <typename Fn>
+        struct then_result<void, Fn> {
+            using type = std::invoke_result_t<Fn>;
+        };
+
+        template <typename T, typename Fn>
+        using then_result_t = typename then_result<T, Fn>::type;
+
+        template <typename T, typename Fn>
+        struct is_continuation: std::is_nothrow_invocable<Fn, T&&> {};
+
+        template <typename Fn>
+        struct is_continuation<void, Fn>: std::is_nothrow_invocable<Fn> {};
+
+        template <typename T, typename Fn>
+        static constexpr bool is_continuation_v = is_continuation<T, Fn>::value;
+    } // namespace internal
+
+    // INFO: Move-only handle to a value that is computed elsewhere; a single task or
+    // thread waits on it.
     template <typename T>
     struct Awaiter {
         using value_type = std::conditional_t<std::is_void_v<T>, void*, T>;
+
+        Awaiter() = default;
+
+        // INFO: Runs `fn` with the value as queued work of the scheduler that created
+        // the awaiter, once the value is ready, and returns the awaiter of its result.
+        // The value is moved into `fn`; nobody blocks on it. The awaiter is consumed.
+        //
+        // NOTE: A continuation that becomes ready after `run` has returned is queued
+        // for the next run.
+        template <typename Fn>
+            requires (internal::is_continuation_v<T, Fn>)
+        auto then(
+            Fn&& fn,
+            ThisThread::Priority p = ThisThread::Priority::normal
+        ) && -> Awaiter<internal::then_result_t<T, Fn>>;
+
         auto await() -> value_type requires (!std::is_void_v<T>) {
             wait();
             return get_value();
@@ -21,50 +246,153 @@ namespace tpl {
             wait();
         }
 
+        // INFO: Awaiting it from a `Coro` parks the task instead of blocking the worker.
+        auto await_ready() const noexcept -> bool {
+            return m_data->is_finished();
+        }
+
+        template <typename P>
+        auto await_suspend(std::coroutine_handle<P> h) -> void {
+            h.promise().park(h, [data = m_data.share()](auto& token) {
+                if (data->is_finished()) return false;
+                auto waker = InplaceFunction<void()>(token.park());
+                // NOTE: Finished in the meantime; the task is signalled right away.
+                if (!data->try_park(waker)) waker();
+                return true;
+            });
+        }
+
+        auto await_resume() -> T {
+            if constexpr (!std::is_void_v<T>) return get_value();
+        }
+
     private:
+        explicit Awaiter(internal::AwaiterRef<T> data, Scheduler* owner = nullptr) noexcept
+            : m_data(std::move(data))
+            , m_owner(owner)
+        {}
+
+        // INFO: A worker runs other ready tasks and queued work while it waits, so
+        // awaiting inside a task does not take the worker away from the pool. It
+        // parks like an idle worker if there is nothing to run and is woken up by
+        // `finish`. Any other thread blocks on the state.
         auto wait() -> void {
-            if (!m_data->finished) {
-                m_data->waiter.wait([this] {
-                    return m_data->finished;
-                });
+            if (m_data->is_finished()) return;
+            auto* pool = WorkerPool::current();
+            auto wake = InplaceFunction<void()>([pool] noexcept { pool->waiter.notify_all(); });
+            if (pool && m_data->try_park(wake)) {
+                pool->help_until([&data = m_data] { return data->is_finished(); });
+                if (m_data->is_finished()) return;
             }
+            m_data->wait();
         }
 
         auto get_value() -> value_type {
-            auto val = *m_data->value;
-            m_data->value = std::nullopt;
-            return val;
+            return m_data->take();
         }
 
         friend struct Scheduler;
+        friend struct internal::AwaiterOps;
+        template <typename U>
+        friend struct Awaiter;
+    private:
+        internal::AwaiterRef<T> m_data{};
+        // INFO: Scheduler that runs the continuations of `then`.
+        Scheduler* m_owner{nullptr};
+    };
 
-        struct Wrapper {
-            internal::Waiter waiter{};
-            std::optional<value_type> value;
-            bool finished{false};
-
-            auto notify_value(value_type val)
-                noexcept (std::is_nothrow_move_constructible_v<value_type>)
-                requires (!std::is_void_v<T>)
-            {
-                value = std::move(val);
-                waiter.notify_all([this]{
-                    finished = true;
+    namespace internal {
+        struct AwaiterOps {
+            // INFO: Calls `fn` with the value on the thread that finishes it, or right
+            // away if it's already finished.
+            template <typename T, typename Fn>
+            static auto on_ready(Awaiter<T>& a, Fn&& fn) -> void {
+                auto* s = a.m_data.get();
+                auto cont = InplaceFunction<void()>([s, fn = std::forward<Fn>(fn)] mutable noexcept {
+                    fn(s->take());
                 });
+                if (s->is_finished() || !s->try_park(cont)) cont();
             }
 
-            auto notify_value()
-                noexcept (std::is_nothrow_move_constructible_v<value_type>)
-                requires (std::is_void_v<T>)
-            {
-                waiter.notify_all([this]{
-                    finished = true;
-                });
+            template <typename T>
+            static auto make(Scheduler* owner) -> Awaiter<T> {
+                return Awaiter<T>(AwaiterRef<T>{}, owner);
+            }
+
+            template <typename T>
+            static auto state(Awaiter<T> const& a) -> AwaiterRef<T> {
+                return a.m_data.share();
+            }
+
+            template <typename T>
+            static auto owner(Awaiter<T> const& a) noexcept -> Scheduler* {
+                return a.m_owner;
             }
         };
-    private:
-        std::shared_ptr<Wrapper> m_data{ std::make_unique<Wrapper>() };
-    };
+
+        template <typename... Ts>
+        struct JoinAll {
+            using result_t = std::tuple<typename Awaiter<Ts>::value_type...>;
+
+            template <std::size_t I, typename V>
+            auto set(V&& val) noexcept -> void {
+                std::get<I>(values).emplace(std::forward<V>(val));
+                if (left.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+                dst->notify_value(std::apply([](auto&... v) {
+                    return result_t(std::move(*v)...);
+                }, values));
+            }
+
+            AwaiterRef<result_t> dst;
+            std::tuple<std::optional<typename Awaiter<Ts>::value_type>...> values{};
+            std::atomic<std::size_t> left{sizeof...(Ts)};
+        };
+
+        template <typename... Ts>
+        struct JoinAny {
+            using result_t = std::variant<typename Awaiter<Ts>::value_type...>;
+
+            template <std::size_t I, typename V>
+            auto set(V&& val) noexcept -> void {
+                if (done.exchange(true, std::memory_order_acq_rel)) return;
+                dst->notify_value(result_t(std::in_place_index<I>, std::forward<V>(val)));
+            }
+
+            AwaiterRef<result_t> dst;
+            std::atomic<bool> done{false};
+        };
+
+        template <typename Join, typename... Ts>
+        auto join(Awaiter<Ts>... as) {
+            using result_t = typename Join::result_t;
+            Scheduler* owner = nullptr;
+            ((owner = owner ? owner : AwaiterOps::owner(as)), ...);
+            auto res = AwaiterOps::make<result_t>(owner);
+            auto j = std::make_shared<Join>(AwaiterOps::state(res));
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (AwaiterOps::on_ready(as, [j](auto&& val) noexcept {
+                    j->template set<I>(std::move(val));
+                }), ...);
+            }(std::index_sequence_for<Ts...>{});
+            return res;
+        }
+    } // namespace internal
+
+    // INFO: Ready once all of the awaiters are; the values are moved into a tuple in
+    // the order of the arguments. A `void` awaiter contributes a null pointer.
+    template <typename... Ts>
+        requires (sizeof...(Ts) > 0)
+    inline auto when_all(Awaiter<Ts>... as) -> Awaiter<typename internal::JoinAll<Ts...>::result_t> {
+        return internal::join<internal::JoinAll<Ts...>>(std::move(as)...);
+    }
+
+    // INFO: Ready once the first of the awaiters is; the variant holds its value at
+    // the index of its argument. The other values are dropped.
+    template <typename... Ts>
+        requires (sizeof...(Ts) > 0)
+    inline auto when_any(Awaiter<Ts>... as) -> Awaiter<typename internal::JoinAny<Ts...>::result_t> {
+        return internal::join<internal::JoinAny<Ts...>>(std::move(as)...);
+    }
 
 } // namespace tpl
 
@@ -2,9 +2,15 @@
 #define AMT_TPL_CHANNEL_HPP
 
 #include <atomic>
+#include <coroutine>
 #include <expected>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
 #include "queue.hpp"
 #include "tpl/allocator.hpp"
+#include "inplace_function.hpp"
 #include "waiter.hpp"
 
 namespace tpl {
@@ -44,11 +50,11 @@ namespace tpl {
             if (is_closed()) return std::unexpected(ChannelError::closed);
             if constexpr (!internal::is_bounded_queue_v<base_type>) {
                 m_queue.push(val);
-                m_waiter.notify_all();
+                notify();
                 return true;
             } else {
                 if (m_queue.push(val)) {
-                    m_waiter.notify_all();
+                    notify();
                     return true;
                 }
                 return false;
@@ -59,11 +65,11 @@ namespace tpl {
             if (is_closed()) return std::unexpected(ChannelError::closed);
             if constexpr (!internal::is_bounded_queue_v<base_type>) {
                 m_queue.push(std::move(val));
-                m_waiter.notify_all();
+                notify();
                 return true;
             } else {
                 if (m_queue.push(std::move(val))) {
-                    m_waiter.notify_all();
+                    notify();
                     return true;
                 }
                 return false;
@@ -74,11 +80,11 @@ namespace tpl {
             if (is_closed()) return std::unexpected(ChannelError::closed);
             if constexpr (!internal::is_bounded_queue_v<base_type>) {
                 m_queue.push(val);
-                m_waiter.notify_all();
+                notify();
             } else {
                 while (true) {
                     if (m_queue.push(val)) {
-                        m_waiter.notify_all();
+                        notify();
                         return {};
                     }
                     m_waiter.wait([this] {
@@ -93,11 +99,11 @@ namespace tpl {
             if (is_closed()) return std::unexpected(ChannelError::closed);
             if constexpr (!internal::is_bounded_queue_v<base_type>) {
                 m_queue.push(std::move(val));
-                m_waiter.notify_all();
+                notify();
             } else {
                 while (true) {
                     if (m_queue.push(val)) {
-                        m_waiter.notify_all();
+                        notify();
                         return {};
                     }
 
@@ -117,7 +123,7 @@ namespace tpl {
             while (true) {
                 auto val = m_queue.pop();
                 if (val) {
-                    m_waiter.notify_all();
+                    notify();
                     return { std::move(*val) };
                 }
 
@@ -130,19 +136,138 @@ namespace tpl {
             return {};
         }
 
-        constexpr auto close() noexcept -> void {
+        auto close() noexcept -> void {
             m_closed.store(true, std::memory_order_release);
-            m_waiter.notify_all();
+            notify();
         }
 
         constexpr auto is_closed() const noexcept -> bool {
             return m_closed.load(std::memory_order_relaxed);
         }
 
+        struct ReceiveAwaitable {
+            BasicChannel* channel;
+            std::optional<value_type> value{};
+            InplaceFunction<void()> waker{};
+
+            auto await_ready() -> bool {
+                if (!try_take()) return false;
+                channel->notify();
+                return true;
+            }
+
+            template <typename P>
+            auto await_suspend(std::coroutine_handle<P> h) -> void {
+                h.promise().park(h, [this](auto& token) {
+                    waker = token.park();
+                    return subscribe();
+                });
+            }
+
+            // INFO: Empty once the channel is closed and drained.
+            auto await_resume() -> std::optional<value_type> {
+                return std::move(value);
+            }
+
+        private:
+            // NOTE: Runs under the channel's lock, so it must not notify.
+            auto try_take() -> bool {
+                value = channel->m_queue.pop();
+                return value.has_value() || channel->is_closed();
+            }
+
+            // INFO: Another receiver may have taken the value by the time this one is
+            // notified, so it only wakes the coroutine once it holds a value.
+            auto subscribe() -> bool {
+                if (channel->subscribe([this] { return try_take(); }, [this] noexcept {
+                    if (!subscribe()) std::exchange(waker, nullptr)();
+                })) return true;
+                channel->notify();
+                return false;
+            }
+        };
+
+        struct SendAwaitable {
+            BasicChannel* channel;
+            value_type value;
+            std::expected<void, ChannelError> result{};
+            InplaceFunction<void()> waker{};
+
+            auto await_ready() -> bool {
+                if (!try_put()) return false;
+                channel->notify();
+                return true;
+            }
+
+            template <typename P>
+            auto await_suspend(std::coroutine_handle<P> h) -> void {
+                h.promise().park(h, [this](auto& token) {
+                    waker = token.park();
+                    return subscribe();
+                });
+            }
+
+            auto await_resume() -> std::expected<void, ChannelError> {
+                return result;
+            }
+
+        private:
+            auto try_put() -> bool {
+                if (channel->is_closed()) {
+                    result = std::unexpected(ChannelError::closed);
+                    return true;
+                }
+                return channel->m_queue.push(value);
+            }
+
+            auto subscribe() -> bool {
+                if (channel->subscribe([this] { return try_put(); }, [this] noexcept {
+                    if (!subscribe()) std::exchange(waker, nullptr)();
+                })) return true;
+                channel->notify();
+                return false;
+            }
+        };
+
+        // INFO: Receives from a `Coro` without blocking the worker; the task is
+        // parked until there is a value or the channel is closed.
+        auto async_receive() noexcept -> ReceiveAwaitable {
+            return { .channel = this };
+        }
+
+        // INFO: Only suspends while a bounded channel is full.
+        auto async_send(value_type val) -> SendAwaitable {
+            return { .channel = this, .value = std::move(val) };
+        }
+
+    private:
+        // INFO: Wakes up the blocked threads and the parked coroutines.
+        auto notify() -> void {
+            auto wakers = std::vector<InplaceFunction<void()>>{};
+            {
+                std::lock_guard lock(m_waiter.mutex);
+                if (!m_wakers.empty()) std::swap(wakers, m_wakers);
+                m_waiter.cv.notify_all();
+            }
+            for (auto& w: wakers) w();
+        }
+
+        // INFO: Calls `fn` after the next notification unless `ready` already holds;
+        // it's checked under the lock, so a notification can't be missed in between.
+        template <typename Ready, typename Fn>
+        auto subscribe(Ready&& ready, Fn&& fn) -> bool {
+            std::lock_guard lock(m_waiter.mutex);
+            if (ready()) return false;
+            m_wakers.emplace_back(std::forward<Fn>(fn));
+            return true;
+        }
+
     private:
         base_type m_queue;
         std::atomic<bool> m_closed{false};
         internal::Waiter m_waiter;
+        // INFO: Parked coroutines; guarded by the waiter's mutex.
+        std::vector<InplaceFunction<void()>> m_wakers;
     };
 
     template <typename T, std::size_t N>
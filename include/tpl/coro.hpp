@@ -0,0 +1,328 @@
+#ifndef AMT_TPL_CORO_HPP
+#define AMT_TPL_CORO_HPP
+
+#include <cassert>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "inplace_function.hpp"
+#include "reactor.hpp"
+#include "task_token.hpp"
+
+namespace tpl {
+
+    template <typename T = void>
+    struct Coro;
+
+    namespace internal {
+        // INFO: Shared by the coroutine of a task and every coroutine it awaits. An
+        // awaitable leaves a `park` function here instead of registering itself in
+        // `await_suspend`, since the event could resume the coroutine on another
+        // worker before the current one has left it. The task runs it once the
+        // coroutine is suspended; it returns false if the task was not parked, e.g.
+        // the event has already happened, and the coroutine is resumed right away.
+        struct CoroRoot {
+            std::coroutine_handle<> current{};
+            InplaceFunction<bool(TaskToken&)> park{};
+        };
+
+        struct CoroPromiseBase {
+            struct FinalAwaiter {
+                constexpr auto await_ready() const noexcept -> bool { return false; }
+
+                // INFO: Continues the awaiting coroutine on the same worker.
+                template <typename P>
+                auto await_suspend(std::coroutine_handle<P> h) noexcept -> std::coroutine_handle<> {
+                    auto next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                constexpr auto await_resume() const noexcept -> void {}
+            };
+
+            constexpr auto initial_suspend() const noexcept -> std::suspend_always { return {}; }
+            constexpr auto final_suspend() const noexcept -> FinalAwaiter { return {}; }
+
+            auto unhandled_exception() noexcept -> void {
+                #ifdef __cpp_exceptions
+                error = std::current_exception();
+                #else
+                std::terminate();
+                #endif
+            }
+
+            // INFO: Called by the awaitables in `await_suspend`; see `CoroRoot`.
+            template <typename Fn>
+            auto park(std::coroutine_handle<> h, Fn&& fn) -> void {
+                assert(root != nullptr && "the coroutine must run as a task");
+                root->current = h;
+                root->park = std::forward<Fn>(fn);
+            }
+
+            auto rethrow() -> void {
+                #ifdef __cpp_exceptions
+                if (error) std::rethrow_exception(std::exchange(error, nullptr));
+                #endif
+            }
+
+            CoroRoot* root{nullptr};
+            std::coroutine_handle<> continuation{};
+            std::exception_ptr error{};
+        };
+
+        template <typename T>
+        struct CoroPromise: CoroPromiseBase {
+            auto get_return_object() noexcept -> Coro<T>;
+
+            template <typename U = T>
+                requires (std::constructible_from<T, U&&>)
+            auto return_value(U&& val) -> void {
+                value.emplace(std::forward<U>(val));
+            }
+
+            auto take() -> T {
+                rethrow();
+                return std::move(*value);
+            }
+
+            std::optional<T> value;
+        };
+
+        template <>
+        struct CoroPromise<void>: CoroPromiseBase {
+            auto get_return_object() noexcept -> Coro<void>;
+
+            constexpr auto return_void() const noexcept -> void {}
+
+            auto take() -> void {
+                rethrow();
+            }
+        };
+
+        template <typename T>
+        struct is_coro: std::false_type {};
+
+        template <typename T>
+        struct is_coro<Coro<T>>: std::true_type {};
+
+        template <typename T>
+        static constexpr bool is_coro_v = is_coro<std::remove_cvref_t<T>>::value;
+
+        template <typename T>
+        struct CoroTask;
+    } // namespace internal
+
+    // INFO: Lazily started coroutine that runs as a task. A task function returning
+    // `Coro<T>` stores a `T` like a plain task returning it. While it's suspended,
+    // the task is parked and its worker is free; the event that resumes it signals
+    // the task again, so any worker of the pool picks it up. It can await
+    // `sleep_for`/`sleep_until`, `readable`/`writable`, an `Awaiter`, a channel's
+    // `async_send`/`async_receive` or another `Coro`.
+    //
+    // NOTE: The token passed to the task function stays valid for the whole
+    // coroutine. A cancelled task is only dropped once the event it waits on fires.
+    template <typename T>
+    struct [[nodiscard]] Coro {
+        using promise_type = internal::CoroPromise<T>;
+        using value_type = T;
+        using handle_t = std::coroutine_handle<promise_type>;
+
+        constexpr Coro() noexcept = default;
+        explicit Coro(handle_t h) noexcept
+            : m_handle(h)
+        {}
+        Coro(Coro const&) = delete;
+        Coro(Coro && other) noexcept
+            : m_handle(std::exchange(other.m_handle, nullptr))
+        {}
+        Coro& operator=(Coro const&) = delete;
+        Coro& operator=(Coro && other) noexcept {
+            if (this == &other) return *this;
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+            return *this;
+        }
+        ~Coro() {
+            if (m_handle) m_handle.destroy();
+        }
+
+        auto done() const noexcept -> bool {
+            return !m_handle || m_handle.done();
+        }
+
+        struct Awaitable {
+            handle_t h;
+
+            auto await_ready() const noexcept -> bool {
+                assert(h && "awaiting an empty coroutine");
+                return h.done();
+            }
+
+            template <typename P>
+            auto await_suspend(std::coroutine_handle<P> parent) noexcept -> std::coroutine_handle<> {
+                h.promise().root = parent.promise().root;
+                h.promise().continuation = parent;
+                return h;
+            }
+
+            auto await_resume() -> T {
+                return h.promise().take();
+            }
+        };
+
+        // INFO: Awaiting another coroutine runs it inline on the awaiting task; its
+        // suspensions park the whole task.
+        auto operator co_await() noexcept -> Awaitable {
+            return { m_handle };
+        }
+    private:
+        template <typename U>
+        friend struct internal::CoroTask;
+    private:
+        handle_t m_handle{};
+    };
+
+    namespace internal {
+        template <typename T>
+        inline auto CoroPromise<T>::get_return_object() noexcept -> Coro<T> {
+            return Coro<T>(std::coroutine_handle<CoroPromise<T>>::from_promise(*this));
+        }
+
+        inline auto CoroPromise<void>::get_return_object() noexcept -> Coro<void> {
+            return Coro<void>(std::coroutine_handle<CoroPromise<void>>::from_promise(*this));
+        }
+
+        // INFO: Body of a task whose function returns `Coro<T>`. The first run starts
+        // the coroutine and the following ones resume it until it's done; a
+        // coroutine left behind by a cancelled run is dropped by the next run.
+        template <typename T>
+        struct CoroTask {
+            template <typename Fn>
+            auto operator()(Fn& fn, TaskToken& t) -> void {
+                if (!m_state || m_state->epoch != t.epoch()) start(fn, t);
+                auto& s = *m_state;
+                while (true) {
+                    s.token.m_result = TaskResult::success;
+                    s.root.current.resume();
+                    if (s.coro.done()) break;
+                    assert(s.root.park && "suspended on an awaitable that does not support tasks");
+                    auto park = std::move(s.root.park);
+                    // NOTE: Another worker may resume the coroutine as soon as it's
+                    // parked, so the state is not touched after that.
+                    auto tmp = TaskToken(t.m_parent, t.m_id, t.m_store, t.m_inputs);
+                    if (park(tmp)) {
+                        t.m_result = TaskResult::rescheduled;
+                        return;
+                    }
+                }
+
+                auto state = std::move(m_state);
+                t.m_result = state->token.m_result;
+                if constexpr (std::is_void_v<T>) {
+                    state->coro.m_handle.promise().take();
+                } else {
+                    auto val = state->coro.m_handle.promise().take();
+                    if (t.is_success()) t.return_(std::move(val));
+                }
+            }
+        private:
+            struct State {
+                explicit State(TaskToken& t)
+                    : token(t.m_parent, t.m_id, t.m_store, t.m_inputs)
+                    , epoch(t.epoch())
+                {}
+
+                TaskToken token;
+                std::size_t epoch;
+                CoroRoot root{};
+                Coro<T> coro{};
+            };
+
+            template <typename Fn>
+            auto start(Fn& fn, TaskToken& t) -> void {
+                m_state = std::make_unique<State>(t);
+                auto& s = *m_state;
+                if constexpr (std::invocable<Fn&, TaskToken&>) {
+                    s.coro = std::invoke(fn, s.token);
+                } else {
+                    s.coro = std::invoke(fn);
+                }
+                s.coro.m_handle.promise().root = &s.root;
+                s.root.current = s.coro.m_handle;
+            }
+        private:
+            std::unique_ptr<State> m_state;
+        };
+    } // namespace internal
+
+    struct SleepAwaitable {
+        std::chrono::steady_clock::time_point tp;
+
+        auto await_ready() const noexcept -> bool {
+            return std::chrono::steady_clock::now() >= tp;
+        }
+
+        template <typename P>
+        auto await_suspend(std::coroutine_handle<P> h) -> void {
+            h.promise().park(h, [tp = tp](TaskToken& t) {
+                t.schedule_at(tp);
+                return t.is_rescheduled();
+            });
+        }
+
+        constexpr auto await_resume() const noexcept -> void {}
+    };
+
+    // INFO: Suspends the coroutine on the scheduler's timer wheel.
+    inline auto sleep_until(std::chrono::steady_clock::time_point tp) noexcept -> SleepAwaitable {
+        return { tp };
+    }
+
+    template <typename Rep, typename Period>
+    inline auto sleep_for(std::chrono::duration<Rep, Period> delay) noexcept -> SleepAwaitable {
+        return { std::chrono::steady_clock::now() + delay };
+    }
+
+    struct IoAwaitable {
+        int fd;
+        IoEvent event;
+        std::expected<void, ReactorError> result{};
+
+        constexpr auto await_ready() const noexcept -> bool { return false; }
+
+        template <typename P>
+        auto await_suspend(std::coroutine_handle<P> h) -> void {
+            h.promise().park(h, [this](TaskToken& t) {
+                auto res = event == IoEvent::readable ? t.wait_readable(fd) : t.wait_writable(fd);
+                if (t.is_rescheduled()) return true;
+                // NOTE: Only written if it's not parked; it could be resumed otherwise.
+                result = res;
+                return false;
+            });
+        }
+
+        auto await_resume() const noexcept -> std::expected<void, ReactorError> {
+            return result;
+        }
+    };
+
+    // INFO: Suspends the coroutine until the descriptor is ready; see `TaskToken::wait_readable`.
+    inline auto readable(int fd) noexcept -> IoAwaitable {
+        return { .fd = fd, .event = IoEvent::readable };
+    }
+
+    inline auto writable(int fd) noexcept -> IoAwaitable {
+        return { .fd = fd, .event = IoEvent::writable };
+    }
+
+} // namespace tpl
+
+#endif // AMT_TPL_CORO_HPP
@@ -4,8 +4,12 @@
 #include <cstdint>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <cassert>
+#include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 
 namespace tpl {
 
@@ -120,10 +124,12 @@ namespace tpl {
             return *get();
         }
 
+        // INFO: Moves the value out once; a borrowed value is moved out of its owner.
         constexpr auto take() noexcept -> value_type {
-            auto val = std::move(*get());
+            value_type val(std::move(*get()));
+            if (m_index == Owned) get()->~value_type();
             m_index = None;
-            return std::move(val);
+            return val;
         }
 
         constexpr auto is_owned() const noexcept -> bool { return m_index == Owned; }
@@ -150,7 +156,10 @@ namespace tpl {
         static constexpr auto npos = std::numeric_limits<size_type>::max();
         enum ValueIndex {
             Owned = 0,
+            // INFO: A view; `take` copies it.
             Borrowed = 1,
+            // INFO: Borrowed from a mutable owner; `take` moves out of it like `Cow<T>`.
+            BorrowedMut = 2,
             None = npos
         };
         static constexpr auto size = std::max(sizeof(value_type), sizeof(std::string_view));
@@ -171,18 +180,36 @@ namespace tpl {
             new(m_data) std::string_view(std::move(val));
         }
 
-        Cow(std::string* val)
-            : m_index(Borrowed)
+        Cow(std::string* val) noexcept
+            : m_index(BorrowedMut)
         {
-            new(m_data) reference(*val);
+            new(m_data) value_type*(val);
         }
 
         Cow(std::string const* val)
-            : m_index(Owned)
+            : m_index(Borrowed)
         {
             new(m_data) reference(*val);
         }
 
+        // INFO: An owned string may point into its own buffer, so it cannot be memcpy-ed.
+        Cow(Cow const&) = delete;
+        Cow(Cow && other) noexcept
+            : m_index(other.m_index)
+        {
+            steal(other);
+        }
+        Cow& operator=(Cow const&) = delete;
+        Cow& operator=(Cow && other) noexcept {
+            if (this == &other) return *this;
+            if (m_index == Owned) {
+                std::destroy_at(reinterpret_cast<value_type*>(m_data));
+            }
+            m_index = other.m_index;
+            steal(other);
+            return *this;
+        }
+
         ~Cow() {
             if (m_index == Owned) {
                 value_type* val = reinterpret_cast<value_type*>(m_data);
@@ -197,6 +224,8 @@ namespace tpl {
                 return *reinterpret_cast<std::string*>(m_data);
             } else if (m_index == Borrowed) {
                 return *reinterpret_cast<std::string_view*>(m_data);
+            } else if (m_index == BorrowedMut) {
+                return **reinterpret_cast<std::string**>(m_data);
             } else {
                 return {};
             }
@@ -209,6 +238,8 @@ namespace tpl {
                 return *reinterpret_cast<std::string const*>(m_data);
             } else if (m_index == Borrowed) {
                 return *reinterpret_cast<std::string_view const*>(m_data);
+            } else if (m_index == BorrowedMut) {
+                return **reinterpret_cast<std::string* const*>(m_data);
             } else {
                 return {};
             }
@@ -222,27 +253,43 @@ namespace tpl {
             return get();
         }
 
+        // INFO: Moves the value out once; only a view is copied.
         constexpr auto take() noexcept -> value_type {
-            if (m_index == Owned) {
+            auto index = std::exchange(m_index, None);
+            if (index == Owned) {
                 auto tmp = reinterpret_cast<std::string*>(m_data);
-                m_index = None;
-                return std::move(*tmp);
-            } else if (m_index == Borrowed) {
-                auto tmp = *reinterpret_cast<std::string_view*>(m_data);
-                m_index = None;
-                return std::string(tmp);
+                auto val = std::move(*tmp);
+                std::destroy_at(tmp);
+                return val;
+            } else if (index == Borrowed) {
+                return std::string(*reinterpret_cast<std::string_view*>(m_data));
+            } else if (index == BorrowedMut) {
+                return std::move(**reinterpret_cast<std::string**>(m_data));
             } else {
                 return {};
             }
         }
 
         constexpr auto is_owned() const noexcept -> bool { return m_index == Owned; }
-        constexpr auto is_borrowed() const noexcept -> bool { return m_index == Borrowed; }
+        constexpr auto is_borrowed() const noexcept -> bool { return m_index == Borrowed || m_index == BorrowedMut; }
 
         constexpr operator bool() const noexcept {
             return m_index != None;
         }
 
+    private:
+        auto steal(Cow& other) noexcept -> void {
+            if (m_index == Owned) {
+                auto str = reinterpret_cast<value_type*>(other.m_data);
+                new(m_data) value_type(std::move(*str));
+                std::destroy_at(str);
+            } else if (m_index == Borrowed) {
+                new(m_data) std::string_view(*reinterpret_cast<std::string_view*>(other.m_data));
+            } else if (m_index == BorrowedMut) {
+                new(m_data) value_type*(*reinterpret_cast<value_type**>(other.m_data));
+            }
+            other.m_index = None;
+        }
     private:
         std::byte m_data[size];
         std::size_t m_index{None};
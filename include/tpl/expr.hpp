@@ -4,6 +4,7 @@
 #include "scheduler.hpp"
 #include "tpl/task.hpp"
 #include <concepts>
+#include <memory>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
@@ -27,7 +28,7 @@ namespace tpl {
         ;
 
         template <typename T>
-        static constexpr auto is_dependency_v = std::same_as<std::decay_t<T>, Scheduler::DependencyTracker>;
+        static constexpr auto is_dependency_v = std::derived_from<std::decay_t<T>, Scheduler::DependencyTracker>;
 
         template <typename C>
         struct Expr;
@@ -119,11 +120,14 @@ namespace tpl {
                 }
             }
 
+            // INFO: Handlers are move-only; the group members share a single one.
             auto set_error_handler(ErrorHandler handler) {
-                for (auto i = 0ul; i < data.size() - 1; ++i) {
-                    data[i].set_error_handler(handler);
+                auto shared = std::make_shared<ErrorHandler>(std::move(handler));
+                for (auto i = 0ul; i < data.size(); ++i) {
+                    data[i].set_error_handler(ErrorHandler([shared](std::exception const& e) {
+                        return (*shared)(e);
+                    }));
                 }
-                data.back().set_error_handler(std::move(handler));
             }
         };
 
@@ -213,7 +217,7 @@ namespace tpl {
         constexpr auto operator()(Scheduler& s) const noexcept -> internal::TaskGroupResult<N> {
             return { .data = [&, this]<std::size_t... Is>(std::index_sequence<Is...>)
                 {
-                    std::array res {
+                    std::array<Scheduler::DependencyTracker, N> res {
                         (s.add_task(std::move(std::get<Is>(group))))...
                     };
                     return res;
@@ -0,0 +1,163 @@
+#ifndef AMT_TPL_INPLACE_FUNCTION_HPP
+#define AMT_TPL_INPLACE_FUNCTION_HPP
+
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "allocator.hpp"
+
+namespace tpl {
+
+    template <typename Sig, std::size_t N = 64>
+    struct InplaceFunction;
+
+    // INFO: Move-only replacement for `std::function` that never allocates for
+    // callables up to `N` bytes. Bigger callables are spilled into the given arena
+    // or, if there is none, into the heap. Unlike `std::function`, the target does
+    // not have to be copyable.
+    template <typename R, typename... Args, std::size_t N>
+    struct InplaceFunction<R(Args...), N> {
+        static constexpr std::size_t capacity = N;
+        static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+        // INFO: Whether `Fn` is stored inside the object without touching any allocator.
+        template <typename Fn>
+        static constexpr bool fits_inline =
+            sizeof(Fn) <= N &&
+            alignof(Fn) <= alignment &&
+            std::is_nothrow_move_constructible_v<Fn>;
+
+        constexpr InplaceFunction() noexcept = default;
+        constexpr InplaceFunction(std::nullptr_t) noexcept {}
+        InplaceFunction(InplaceFunction const&) = delete;
+        InplaceFunction(InplaceFunction && other) noexcept {
+            take(other);
+        }
+        InplaceFunction& operator=(InplaceFunction const&) = delete;
+        InplaceFunction& operator=(InplaceFunction && other) noexcept {
+            if (this == &other) return *this;
+            reset();
+            take(other);
+            return *this;
+        }
+        ~InplaceFunction() noexcept {
+            reset();
+        }
+
+        template <typename Fn>
+            requires (
+                !std::same_as<std::decay_t<Fn>, InplaceFunction> &&
+                std::invocable<std::decay_t<Fn>&, Args...>
+            )
+        InplaceFunction(Fn&& fn, BlockAllocator* arena = nullptr) {
+            using fn_t = std::decay_t<Fn>;
+            if constexpr (fits_inline<fn_t>) {
+                new(m_buffer) fn_t(std::forward<Fn>(fn));
+                m_vtable = &inline_vtable<fn_t>;
+            } else {
+                auto ptr = arena
+                    ? arena->alloc<fn_t>()
+                    : static_cast<fn_t*>(::operator new(sizeof(fn_t), std::align_val_t{ alignof(fn_t) }));
+                new(ptr) fn_t(std::forward<Fn>(fn));
+                new(m_buffer) Spilled{ .ptr = ptr, .arena = arena };
+                m_vtable = &spilled_vtable<fn_t>;
+            }
+        }
+
+        auto operator()(Args... args) const -> R {
+            assert(m_vtable != nullptr && "calling an empty function");
+            return m_vtable->invoke(const_cast<std::byte*>(m_buffer), std::forward<Args>(args)...);
+        }
+
+        constexpr explicit operator bool() const noexcept {
+            return m_vtable != nullptr;
+        }
+
+        // INFO: True if the target lives outside of the object.
+        constexpr auto is_spilled() const noexcept -> bool {
+            return m_vtable != nullptr && m_vtable->spilled;
+        }
+
+        auto reset() noexcept -> void {
+            if (!m_vtable) return;
+            m_vtable->destroy(m_buffer);
+            m_vtable = nullptr;
+        }
+
+    private:
+        struct Spilled {
+            void* ptr;
+            BlockAllocator* arena;
+        };
+
+        struct VTable {
+            R (*invoke)(void*, Args&&...);
+            // INFO: Move constructs the target into `dst` and destroys the one in `src`.
+            void (*relocate)(void* dst, void* src) noexcept;
+            void (*destroy)(void*) noexcept;
+            bool spilled;
+        };
+
+        template <typename Fn>
+        static auto invoke_target(Fn& fn, Args&&... args) -> R {
+            if constexpr (std::is_void_v<R>) {
+                std::invoke(fn, std::forward<Args>(args)...);
+            } else {
+                return std::invoke(fn, std::forward<Args>(args)...);
+            }
+        }
+
+        template <typename Fn>
+        static constexpr VTable inline_vtable {
+            .invoke = [](void* buf, Args&&... args) -> R {
+                return invoke_target(*std::launder(static_cast<Fn*>(buf)), std::forward<Args>(args)...);
+            },
+            .relocate = [](void* dst, void* src) noexcept {
+                auto fn = std::launder(static_cast<Fn*>(src));
+                new(dst) Fn(std::move(*fn));
+                std::destroy_at(fn);
+            },
+            .destroy = [](void* buf) noexcept {
+                std::destroy_at(std::launder(static_cast<Fn*>(buf)));
+            },
+            .spilled = false
+        };
+
+        template <typename Fn>
+        static constexpr VTable spilled_vtable {
+            .invoke = [](void* buf, Args&&... args) -> R {
+                auto s = std::launder(static_cast<Spilled*>(buf));
+                return invoke_target(*static_cast<Fn*>(s->ptr), std::forward<Args>(args)...);
+            },
+            .relocate = [](void* dst, void* src) noexcept {
+                new(dst) Spilled(*std::launder(static_cast<Spilled*>(src)));
+            },
+            .destroy = [](void* buf) noexcept {
+                auto s = std::launder(static_cast<Spilled*>(buf));
+                auto fn = static_cast<Fn*>(s->ptr);
+                std::destroy_at(fn);
+                if (s->arena) s->arena->dealloc(fn);
+                else ::operator delete(fn, std::align_val_t{ alignof(Fn) });
+            },
+            .spilled = true
+        };
+
+        auto take(InplaceFunction& other) noexcept -> void {
+            if (!other.m_vtable) return;
+            other.m_vtable->relocate(m_buffer, other.m_buffer);
+            m_vtable = std::exchange(other.m_vtable, nullptr);
+        }
+
+    private:
+        VTable const* m_vtable{nullptr};
+        alignas(alignment) std::byte m_buffer[N];
+    };
+
+} // namespace tpl
+
+#endif // AMT_TPL_INPLACE_FUNCTION_HPP
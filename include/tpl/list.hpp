@@ -2,6 +2,7 @@
 #define AMT_TPL_LINK_LIST_HPP
 
 #include "atomic.hpp"
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <bit>
@@ -95,13 +96,20 @@ namespace tpl {
         BlockSizedList(BlockSizedList &&) noexcept = delete;
         BlockSizedList& operator=(BlockSizedList const&) noexcept = delete;
         BlockSizedList& operator=(BlockSizedList &&) noexcept = delete;
-        ~BlockSizedList() noexcept = default;
+        ~BlockSizedList() noexcept {
+            clear();
+        }
 
         BlockSizedList(std::pmr::polymorphic_allocator<std::byte> alloc) noexcept
             : m_alloc(std::move(alloc))
         {}
 
         void push_back(value_type val) noexcept(std::is_nothrow_move_assignable_v<value_type>) {
+            // INFO: Fast path; avoid allocating a whole block if the head has room.
+            if (node_t* head = m_head.load(std::memory_order_acquire); head) {
+                if (try_push_element(head, val)) return;
+            }
+
             auto* node = m_alloc.new_object<node_t>();
             node->data[0] = std::move(val);
             node->size = 1;
@@ -120,7 +128,7 @@ namespace tpl {
                         head->next.store(node);
                     }
                     auto idx = m_count.fetch_add(1);
-                    if (idx < m_cache.size()) m_cache[idx] = node;
+                    register_block(idx, node);
                     break;
                 }
             }
@@ -138,14 +146,7 @@ namespace tpl {
             auto [b_idx, pos] = map_index(k);
             assert(b_idx < m_count.load(std::memory_order_relaxed));
 
-            if (b_idx < m_cache.size()) return m_cache[b_idx]->data[pos];
-            node_t* last = m_cache.back();
-            b_idx -= m_cache.size() - 1;
-            while (last && b_idx != 0) {
-                last = last->next.load(std::memory_order_relaxed);
-                b_idx -= 1;
-            }
-            return last->data[pos];
+            return get_block(b_idx)->data[pos];
         }
 
         constexpr auto operator[](size_type k) const noexcept -> const_reference {
@@ -184,15 +185,8 @@ namespace tpl {
                 }
             };
             auto count = m_count.load(std::memory_order_relaxed);
-            auto sz = std::min(count, m_cache.size());
-            for (auto j = 0ul; j < sz; ++j) {
-                iter(*m_cache[j]);
-            }
-            node_t* root = m_cache[m_cache.size() - 1];
-            if (!root) return;
-            root = root->next.load(std::memory_order_relaxed);
-            while (root) {
-                root = root->next.load(std::memory_order_relaxed);
+            for (auto j = 0ul; j < count; ++j) {
+                iter(*get_block(j));
             }
         }
 
@@ -212,15 +206,8 @@ namespace tpl {
                 }
             };
             auto count = m_count.load(std::memory_order_relaxed);
-            auto sz = std::min(count, m_cache.size());
-            for (auto j = 0ul; j < sz; ++j) {
-                iter(*m_cache[j]);
-            }
-            node_t* root = m_cache[m_cache.size() - 1];
-            if (!root) return;
-            root = root->next.load(std::memory_order_relaxed);
-            while (root) {
-                root = root->next.load(std::memory_order_relaxed);
+            for (auto j = 0ul; j < count; ++j) {
+                iter(*get_block(j));
             }
         }
 
@@ -248,7 +235,10 @@ namespace tpl {
             m_tail = nullptr;
             m_head = nullptr;
             m_count = 0;
-            for(auto i = 0ul; i < m_cache.size(); ++i) m_cache[i] = nullptr;
+            for (auto i = 0ul; i < m_blocks.size(); ++i) {
+                auto* chunk = m_blocks[i].exchange(nullptr, std::memory_order_relaxed);
+                if (chunk) m_alloc.deallocate_object(chunk, chunk_size(i));
+            }
         }
 
         constexpr auto begin() noexcept -> iterator {
@@ -292,11 +282,44 @@ namespace tpl {
             };
         }
 
+        static constexpr auto chunk_size(size_type chunk) noexcept -> size_type {
+            return size_type{1} << chunk;
+        }
+
+        // INFO: Chunk `k` holds `2^k` block pointers; block `b` lives in the chunk
+        // `floor(log2(b + 1))` at the offset `b + 1 - 2^k`.
+        static constexpr auto locate_block(size_type b_idx) noexcept -> std::pair<size_type, size_type> {
+            auto n = b_idx + 1;
+            auto chunk = static_cast<size_type>(std::bit_width(n)) - 1;
+            return { chunk, n - chunk_size(chunk) };
+        }
+
+        auto register_block(size_type b_idx, node_t* node) -> void {
+            auto [c, off] = locate_block(b_idx);
+            auto* chunk = m_blocks[c].load(std::memory_order_acquire);
+            if (!chunk) {
+                auto* tmp = m_alloc.allocate_object<node_t*>(chunk_size(c));
+                std::fill_n(tmp, chunk_size(c), nullptr);
+                if (m_blocks[c].compare_exchange_strong(chunk, tmp, std::memory_order_acq_rel)) {
+                    chunk = tmp;
+                } else {
+                    m_alloc.deallocate_object(tmp, chunk_size(c));
+                }
+            }
+            chunk[off] = node;
+        }
+
+        constexpr auto get_block(size_type b_idx) const noexcept -> node_t* {
+            auto [c, off] = locate_block(b_idx);
+            return m_blocks[c].load(std::memory_order_acquire)[off];
+        }
+
     private:
         std::atomic<node_t*> m_tail{};
         alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<node_t*> m_head{};
         std::atomic<std::size_t> m_count{};
-        std::array<node_t*, 64ul> m_cache{}; // keep cache for fast look up
+        // INFO: Block directory for constant time look up.
+        std::array<std::atomic<node_t**>, sizeof(size_type) * 8> m_blocks{};
         std::pmr::polymorphic_allocator<std::byte> m_alloc;
     };
 
@@ -0,0 +1,45 @@
+#ifndef AMT_TPL_PORTS_HPP
+#define AMT_TPL_PORTS_HPP
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+
+namespace tpl {
+
+    // INFO: Return type of a task with several outputs. Every element is stored as
+    // its own value, so consumers depend on a single port and the element can be
+    // moved into its only consumer without touching the others.
+    template <typename... Ts>
+        requires (sizeof...(Ts) > 0)
+    struct Ports: std::tuple<Ts...> {
+        using std::tuple<Ts...>::tuple;
+    };
+
+    template <typename... Ts>
+    Ports(Ts...) -> Ports<Ts...>;
+
+    namespace internal {
+        template <typename T>
+        struct is_ports: std::false_type {};
+
+        template <typename... Ts>
+        struct is_ports<Ports<Ts...>>: std::true_type {};
+
+        template <typename T>
+        static constexpr bool is_ports_v = is_ports<std::remove_cvref_t<T>>::value;
+    } // namespace internal
+
+} // namespace tpl
+
+template <typename... Ts>
+struct std::tuple_size<tpl::Ports<Ts...>>
+    : std::integral_constant<std::size_t, sizeof...(Ts)>
+{};
+
+template <std::size_t I, typename... Ts>
+struct std::tuple_element<I, tpl::Ports<Ts...>>
+    : std::tuple_element<I, std::tuple<Ts...>>
+{};
+
+#endif // AMT_TPL_PORTS_HPP
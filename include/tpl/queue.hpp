@@ -2,9 +2,11 @@
 #define AMT_TPL_QUEUE_HPP
 
 #include <atomic>
+#include <concepts>
 #include <cstdint>
 #include <memory_resource>
 #include <print>
+#include <ranges>
 #include <utility>
 #include "basic.hpp"
 #include "maths.hpp"
@@ -376,19 +378,12 @@ namespace tpl {
                     }
 
                     if (!node) {
-                        node = m_free_nodes.pop().value_or(nullptr);
-                        if (!node) {
-                            node = m_alloc.new_object<Node>();
-                        } else {
-                            node->q.reset();
-                            node->next = nullptr;
-                        }
+                        node = make_node();
+                        if (!node) return false;
                         node->q.push_value(val);
                         node_holder.reset_protection(node);
                     }
 
-                    if (!node) return false;
-
                     if (!m_head.compare_exchange_weak(
                         head,
                         node,
@@ -418,6 +413,56 @@ namespace tpl {
             return res;
         }
 
+        // INFO: Pushes the whole range with a single CAS on the head. The items are
+        // written into nodes no other thread can see yet, which are then linked
+        // behind the current head at once, so consumers see them in order. The
+        // batch starts a new node instead of filling the current head one.
+        template <std::ranges::input_range R>
+            requires std::convertible_to<std::ranges::range_reference_t<R>, T>
+        TPL_ATOMIC_FUNC_ATTR auto push_range(R&& range) -> bool {
+            assert(!is_set_queue_state(QUEUE_STATE_RESET));
+            set_queue_state(QUEUE_STATE_PUSH);
+            auto res = [this, &range] -> bool {
+                Node* first{};
+                Node* last{};
+                for (auto&& el: range) {
+                    auto item = std::bit_cast<typename internal::storage_value<sizeof(T)>::type>(static_cast<T>(el));
+                    auto val = static_cast<node_inner_t::value_t>(item);
+                    if (last && last->q.push_value(val)) continue;
+                    auto node = make_node();
+                    if (!node) return false;
+                    node->q.push_value(val);
+                    if (last) last->next.store(node, std::memory_order_relaxed);
+                    else first = node;
+                    last = node;
+                }
+                if (!first) return true;
+
+                while (true) {
+                    auto holder = make_hazard_pointer(m_domain);
+                    auto head = holder.protect(m_head);
+                    if (!m_head.compare_exchange_weak(
+                        head,
+                        last,
+                        std::memory_order_release,
+                        std::memory_order_relaxed
+                    )) {
+                        continue;
+                    }
+
+                    // (old head) -> first -> ... -> last(new head)
+                    if (head) {
+                        head->next.store(first, std::memory_order_release);
+                    } else {
+                        m_tail.store(first);
+                    }
+                    return true;
+                }
+            }();
+            clear_queue_state(QUEUE_STATE_PUSH);
+            return res;
+        }
+
         auto pop() -> std::optional<T> {
             assert(!is_set_queue_state(QUEUE_STATE_RESET));
             set_queue_state(QUEUE_STATE_POP);
@@ -467,6 +512,15 @@ namespace tpl {
                 alloc.delete_object(n);
             }, m_domain);
         }
+        // INFO: A recycled node if there is one; it's only visible to the caller.
+        auto make_node() -> Node* {
+            auto node = m_free_nodes.pop().value_or(nullptr);
+            if (!node) return m_alloc.new_object<Node>();
+            node->q.reset();
+            node->next = nullptr;
+            return node;
+        }
+
         constexpr auto push_back(Node* node) noexcept -> void {
             if (!node) return;
 
@@ -0,0 +1,266 @@
+#ifndef AMT_TPL_REACTOR_HPP
+#define AMT_TPL_REACTOR_HPP
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "allocator.hpp"
+#include "inplace_function.hpp"
+#include "thread.hpp"
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <unistd.h>
+#endif
+
+namespace tpl {
+
+    enum class ReactorError {
+        unsupported,
+        invalid_fd,
+        busy,
+        system
+    };
+
+    constexpr auto to_string(ReactorError e) noexcept -> std::string_view {
+        switch (e) {
+            case ReactorError::unsupported: return "I/O readiness is not supported on this platform";
+            case ReactorError::invalid_fd: return "Invalid file descriptor";
+            case ReactorError::busy: return "Someone is already waiting on the file descriptor";
+            case ReactorError::system: return "The system call failed; see errno";
+        }
+    }
+
+    enum class IoEvent: std::uint8_t {
+        readable = 1,
+        writable = 2
+    };
+
+    // INFO: Waits for file descriptors to become ready on its own thread and runs a
+    // callback once per registration (epoll with `EPOLLONESHOT`), so a waiter is
+    // resumed exactly once and has to register again for the next event. A descriptor
+    // can have one reader and one writer at a time, and they must be removed with
+    // `unwatch` before it's closed; the kernel drops closed descriptors silently.
+    // Errors and hang-ups wake both. The thread is only started by the first
+    // registration. On other platforms every registration fails with
+    // `ReactorError::unsupported`.
+    struct Reactor {
+        using callback_t = InplaceFunction<void()>;
+
+        explicit Reactor(BlockAllocator* arena = nullptr, std::size_t stack_size = 0) noexcept
+            : m_arena(arena)
+            , m_stack_size(stack_size)
+        {}
+        Reactor(Reactor const&) = delete;
+        Reactor(Reactor &&) = delete;
+        Reactor& operator=(Reactor const&) = delete;
+        Reactor& operator=(Reactor &&) = delete;
+        // INFO: Waiters that have not been woken up are dropped without running them.
+        ~Reactor() {
+            stop();
+            for (auto const& w: m_watch) {
+                for (auto e: w) {
+                    if (e) free_entry(e);
+                }
+            }
+            #ifdef __linux__
+            if (m_epoll != -1) ::close(m_epoll);
+            if (m_wake != -1) ::close(m_wake);
+            #endif
+        }
+
+        template <typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, Fn>)
+        auto watch(int fd, IoEvent ev, Fn&& fn) -> std::expected<void, ReactorError> {
+            #ifdef __linux__
+            if (fd < 0) return std::unexpected(ReactorError::invalid_fd);
+            if (auto res = start(); !res) return res;
+
+            auto e = make_entry(std::forward<Fn>(fn));
+            std::lock_guard lock(m_mutex);
+            auto idx = static_cast<std::size_t>(fd);
+            if (m_watch.size() <= idx) m_watch.resize(idx + 1);
+            auto& slot = m_watch[idx][ev == IoEvent::readable ? 0 : 1];
+            if (slot != nullptr) {
+                free_entry(e);
+                return std::unexpected(ReactorError::busy);
+            }
+
+            // INFO: The lock keeps the event from being dispatched before it's stored.
+            slot = e;
+            if (!arm(fd, m_watch[idx])) {
+                slot = nullptr;
+                free_entry(e);
+                return std::unexpected(errno == EBADF ? ReactorError::invalid_fd : ReactorError::system);
+            }
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+            return {};
+            #else
+            (void)fd;
+            (void)ev;
+            (void)fn;
+            return std::unexpected(ReactorError::unsupported);
+            #endif
+        }
+
+        // INFO: Removes the waiters of the descriptor and runs their callbacks, so
+        // whoever waited finds out by itself that the descriptor is gone.
+        auto unwatch(int fd) -> bool {
+            #ifdef __linux__
+            auto w = waiters_t{};
+            {
+                std::lock_guard lock(m_mutex);
+                auto idx = static_cast<std::size_t>(fd);
+                if (fd < 0 || m_watch.size() <= idx) return false;
+                w = std::exchange(m_watch[idx], waiters_t{});
+                if (!w[0] && !w[1]) return false;
+                (void)::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            }
+            for (auto e: w) {
+                if (e) fire(e);
+            }
+            return true;
+            #else
+            (void)fd;
+            return false;
+            #endif
+        }
+
+        // INFO: Waiters that are registered but have not been woken up yet.
+        auto pending() const noexcept -> std::size_t {
+            return m_pending.load(std::memory_order_acquire);
+        }
+
+        auto stop() -> void {
+            std::lock_guard lock(m_thread_mutex);
+            if (!m_thread.joinable()) return;
+            m_running.store(false, std::memory_order_release);
+            #ifdef __linux__
+            auto one = std::uint64_t{1};
+            (void)!::write(m_wake, &one, sizeof(one));
+            #endif
+            m_thread.join();
+        }
+    private:
+        struct Entry {
+            callback_t fn;
+        };
+        // INFO: Reader and writer of a descriptor.
+        using waiters_t = std::array<Entry*, 2>;
+
+        template <typename Fn>
+        auto make_entry(Fn&& fn) -> Entry* {
+            Entry* e = m_arena ? m_arena->alloc<Entry>() : static_cast<Entry*>(::operator new(sizeof(Entry)));
+            return new(e) Entry{ .fn = callback_t(std::forward<Fn>(fn), m_arena) };
+        }
+
+        auto free_entry(Entry* e) noexcept -> void {
+            std::destroy_at(e);
+            if (m_arena) m_arena->dealloc(e);
+            else ::operator delete(e);
+        }
+
+        auto fire(Entry* e) noexcept -> void {
+            e->fn();
+            free_entry(e);
+            m_pending.fetch_sub(1, std::memory_order_release);
+        }
+
+        #ifdef __linux__
+        auto start() -> std::expected<void, ReactorError> {
+            if (m_started.load(std::memory_order_acquire)) return {};
+            std::lock_guard lock(m_thread_mutex);
+            if (m_started.load(std::memory_order_relaxed)) return {};
+            m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+            if (m_epoll == -1) return std::unexpected(ReactorError::system);
+            m_wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            auto event = epoll_event{};
+            event.events = EPOLLIN;
+            event.data.fd = m_wake;
+            if (m_wake == -1 || ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &event) == -1) {
+                if (m_wake != -1) ::close(std::exchange(m_wake, -1));
+                ::close(std::exchange(m_epoll, -1));
+                return std::unexpected(ReactorError::system);
+            }
+            m_running.store(true, std::memory_order_relaxed);
+            m_thread = Thread(m_stack_size, [this] { loop(); });
+            m_started.store(true, std::memory_order_release);
+            return {};
+        }
+
+        // INFO: A one-shot descriptor stays registered after it fired, so it's re-armed
+        // with the interest of the remaining waiters.
+        auto arm(int fd, waiters_t const& w) noexcept -> bool {
+            auto event = epoll_event{};
+            event.events = EPOLLONESHOT | EPOLLRDHUP
+                | (w[0] ? EPOLLIN : 0u)
+                | (w[1] ? EPOLLOUT : 0u);
+            event.data.fd = fd;
+            if (::epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &event) == 0) return true;
+            return errno == ENOENT && ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+        }
+
+        auto loop() -> void {
+            static constexpr int max_events = 64;
+            epoll_event events[max_events];
+            while (m_running.load(std::memory_order_acquire)) {
+                auto n = ::epoll_wait(m_epoll, events, max_events, -1);
+                for (auto i = 0; i < n; ++i) {
+                    auto fd = events[i].data.fd;
+                    if (fd == m_wake) {
+                        auto value = std::uint64_t{};
+                        (void)!::read(m_wake, &value, sizeof(value));
+                        continue;
+                    }
+                    auto flags = events[i].events;
+                    auto failed = (flags & (EPOLLERR | EPOLLHUP)) != 0;
+                    auto ready = waiters_t{};
+                    {
+                        std::lock_guard lock(m_mutex);
+                        auto idx = static_cast<std::size_t>(fd);
+                        if (idx >= m_watch.size()) continue;
+                        auto& w = m_watch[idx];
+                        if (failed || (flags & (EPOLLIN | EPOLLRDHUP))) ready[0] = std::exchange(w[0], nullptr);
+                        if (failed || (flags & EPOLLOUT)) ready[1] = std::exchange(w[1], nullptr);
+                        if (w[0] || w[1]) (void)arm(fd, w);
+                    }
+                    // NOTE: Null if it was removed by `unwatch` after the event came in.
+                    for (auto e: ready) {
+                        if (e) fire(e);
+                    }
+                }
+            }
+        }
+        #endif
+    private:
+        BlockAllocator* m_arena;
+        std::size_t m_stack_size;
+        #ifdef __linux__
+        int m_epoll{-1};
+        // INFO: Eventfd that wakes up the thread to stop it.
+        int m_wake{-1};
+        #endif
+        // INFO: Indexed by the descriptor; guarded by `m_mutex`.
+        std::vector<waiters_t> m_watch;
+        std::atomic<std::size_t> m_pending{0};
+        std::atomic<bool> m_running{false};
+        std::atomic<bool> m_started{false};
+        std::mutex m_mutex;
+        // INFO: Serializes starting and stopping the thread.
+        std::mutex m_thread_mutex;
+        Thread m_thread;
+    };
+
+} // namespace tpl
+
+#endif // AMT_TPL_REACTOR_HPP
@@ -3,6 +3,7 @@
 
 #include "signal_tree/tree.hpp"
 #include "task.hpp"
+#include "inplace_function.hpp"
 #include "signal_tree/int.hpp"
 #include "thread.hpp"
 #include "list.hpp"
@@ -13,16 +14,28 @@
 #include "task_token.hpp"
 #include "atomic.hpp"
 #include "value_store.hpp"
+#include "work_stealing_deque.hpp"
+#include "timer_wheel.hpp"
+#include "reactor.hpp"
+#include "coro.hpp"
+#include "stats.hpp"
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <concepts>
 #include <cstdint>
 #include <functional>
+#include <istream>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <ostream>
 #include <print>
+#include <ranges>
+#include <string>
 #include <type_traits>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <span>
@@ -36,13 +49,17 @@ namespace tpl {
 
     enum class SchedulerError {
         no_root_task,
-        cycle_found
+        cycle_found,
+        invalid_profile,
+        deadline_exceeded
     };
 
     constexpr auto to_string(SchedulerError e) noexcept -> std::string_view {
         switch (e) {
             case SchedulerError::no_root_task: return "There must be a root task that does not depends on any other tasks.";
             case SchedulerError::cycle_found: return "Cycle detected";
+            case SchedulerError::invalid_profile: return "Profile does not match the graph";
+            case SchedulerError::deadline_exceeded: return "Tasks were cancelled since the deadline has passed";
         }
     }
 
@@ -51,24 +68,125 @@ namespace tpl {
         using signal_tree = SignalTree<capacity>;
 
         Scheduler()
-            : m_pool(*this)
+            : Scheduler(SchedulerConfig{})
         {}
+        explicit Scheduler(SchedulerConfig config)
+            : m_own_pool(std::make_unique<WorkerPool>(std::move(config)))
+            , m_pool(m_own_pool.get())
+            , m_local(std::make_unique<LocalQueue[]>(m_pool->size()))
+        {
+            init_local_queues();
+        }
+        // INFO: Unlike the config, it's not overridden by the environment.
+        explicit Scheduler(std::size_t nthreads, IdlePolicy idle = {})
+            : Scheduler(SchedulerConfig{ .nthreads = nthreads, .idle = idle, .use_env = false })
+        {}
+        // INFO: Runs on a pool that is shared with other schedulers; see `WorkerPool`.
+        explicit Scheduler(WorkerPool& pool)
+            : m_pool(&pool)
+            , m_local(std::make_unique<LocalQueue[]>(m_pool->size()))
+        {
+            init_local_queues();
+        }
         Scheduler(Scheduler const&) = delete;
         Scheduler(Scheduler &&) = delete;
         Scheduler& operator=(Scheduler const&) = delete;
         Scheduler& operator=(Scheduler &&) = delete;
-        ~Scheduler() = default;
+        // INFO: The timer and reactor callbacks touch the scheduler, so their threads
+        // have to stop before any member goes away.
+        ~Scheduler() {
+            m_timers.stop();
+            m_reactor.stop();
+        }
     private:
         friend struct TaskToken;
         friend struct WorkerPool;
-        using queue_item_t = std::function<void()>;
+        friend struct internal::Waker;
+        using queue_item_t = InplaceFunction<void()>;
+
+        auto init_local_queues() noexcept -> void {
+            for (auto i = 0ul; i < m_pool->size(); ++i) {
+                m_local[i].seed = i + 1;
+            }
+            m_os_priority = m_pool->config().os_priority;
+        }
 
         enum class TaskState: std::uint8_t {
             empty = 0,
             alive = 1,
             dead  = 2
         };
-        struct TaskInfo {
+        static constexpr auto npos = std::numeric_limits<std::size_t>::max();
+        using slot_t = std::uint32_t;
+        static constexpr auto no_slot = std::numeric_limits<slot_t>::max();
+
+        // INFO: Hot scheduling state of a task. The per-task state is split into parallel
+        // arrays indexed by the slot: the nodes are 16 bytes so `on_complete` touches a
+        // few bytes per successor, the closures live in `m_bodies`, and the edges are
+        // compressed rows built by `analyze`.
+        struct TaskNode {
+            // INFO: When the signal reaches zero, the task is ready to be processed.
+            std::atomic<std::int32_t> signals{};
+            std::atomic<TaskState> state{TaskState::empty};
+            // This can be non-atomic since we guarantee the task is owned by a single thread.
+            bool has_signaled{false};
+            // INFO: `priority_lane` of the task; cached so the hot path never touches the closure.
+            std::uint8_t lane{};
+            // INFO: Snapshot of `signals` taken by `Scheduler::compile`.
+            std::int32_t initial_signals{};
+            // INFO: Intrusive link for the free-slot list; only meaningful while the slot is empty.
+            slot_t next_free{no_slot};
+
+            TaskNode() noexcept = default;
+            TaskNode(TaskNode const&) = delete;
+            TaskNode(TaskNode && other) noexcept
+                : signals(other.signals.load())
+                , state(other.state.load())
+                , has_signaled(other.has_signaled)
+                , lane(other.lane)
+                , initial_signals(other.initial_signals)
+                , next_free(other.next_free)
+            {}
+            TaskNode& operator=(TaskNode const&) = delete;
+            TaskNode& operator=(TaskNode && other) noexcept {
+                if (this == &other) return *this;
+                signals.store(other.signals.load());
+                state.store(other.state.load());
+                has_signaled = other.has_signaled;
+                lane = other.lane;
+                initial_signals = other.initial_signals;
+                next_free = other.next_free;
+                return *this;
+            }
+            ~TaskNode() = default;
+        };
+
+        // INFO: A task waiting on the timer wheel or the reactor. `epoch` is the run
+        // that parked it or zero; whoever clears it resumes the task, so the waker and
+        // the deadline of `run` never both do.
+        struct ParkSlot {
+            std::atomic<std::size_t> epoch{0};
+            // INFO: Descriptor passed to `TaskToken::wait_for_io`, or -1 for a timer.
+            int fd{-1};
+
+            ParkSlot() noexcept = default;
+            ParkSlot(ParkSlot const&) = delete;
+            ParkSlot(ParkSlot && other) noexcept
+                : epoch(other.epoch.load())
+                , fd(other.fd)
+            {}
+            ParkSlot& operator=(ParkSlot const&) = delete;
+            ParkSlot& operator=(ParkSlot && other) noexcept {
+                if (this == &other) return *this;
+                epoch.store(other.epoch.load());
+                fd = other.fd;
+                return *this;
+            }
+            ~ParkSlot() = default;
+        };
+
+        // INFO: Cold part of a task; only touched when the task runs.
+        struct TaskBody {
             Task task;
 
             // INFO: It stores the exceptions that is thrown by task.
@@ -80,66 +198,147 @@ namespace tpl {
                 // INFO: Unhandled exceptions
                 std::exception_ptr expception_ptr;
             #endif
+        };
 
-            // INFO: Dependencies to signal when this completes
-            std::vector<TaskId> dep_signals{};
+        struct edge_t {
+            slot_t from;
+            slot_t to;
+            // INFO: Value the consumer reads; the producer itself or one of its ports.
+            TaskId key;
 
-            // INFO: Keeps track of inputs for verification
-            std::vector<std::pair<TaskId, bool /*consumable*/>> inputs;
-            // This can be non-atomic since we guarantee the task is owned by a single thread.
-            bool has_signaled{false};
+            constexpr auto operator<=>(edge_t const&) const noexcept = default;
+        };
+        using input_t = std::pair<TaskId, bool /*consumable*/>;
+
+        // INFO: Port ids of a task with `Ports` outputs; `base..base + count` are
+        // its ports. The ids are kept when the slot is reused, so `reserved` is the
+        // number of ids it owns.
+        struct PortRange {
+            slot_t base{};
+            slot_t count{};
+            slot_t reserved{};
+        };
 
-            // INFO: This indicates whether the value produced by this task
-            // will be fed into multiple tasks. If set true, the value from
-            // the value store will not be consumed by it'll be cloned.
-            constexpr bool produces_immovable_value() const noexcept {
-                return dep_signals.size() > 1;
+        // INFO: One set of signal trees per `ThisThread::Priority`; lane zero is the most urgent.
+        static constexpr std::size_t lanes = 7;
+        static constexpr std::size_t normal_lane = 3;
+        // INFO: Every `aging_period` picks a worker scans the lanes from the least urgent
+        // one so that a steady stream of urgent tasks cannot starve the rest.
+        static constexpr std::size_t aging_period = 64;
+        // INFO: A compiled graph is ranked again before a run once a task's run time is
+        // this many times longer or shorter than the one it was ranked with.
+        static constexpr std::uint64_t replan_ratio = 2;
+
+        static constexpr auto priority_lane(Task::priority_t p) noexcept -> std::size_t {
+            using priority_t = Task::priority_t;
+            switch (p) {
+                case priority_t::realtime: return 0;
+                case priority_t::highest: return 1;
+                case priority_t::above_normal: return 2;
+                case priority_t::normal: return 3;
+                case priority_t::below_normal: return 4;
+                case priority_t::lowest: return 5;
+                case priority_t::idle: return 6;
             }
+            return normal_lane;
+        }
 
-            // INFO: Since modifying vector will introduce the race condition,
-            // we use this atomic. When this signal reaches to zeros, we
-            // signal the queue to start the this task for processing.
-            alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<int> signals{};
-            alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<TaskState> state{TaskState::empty};
+        struct Lane {
+            BlockSizedList<signal_tree, 1> trees;
+            // INFO: Number of signaled tasks; lets workers skip empty lanes without
+            // touching the trees. It's incremented before the signal is set and
+            // decremented after a successful select so it never underflows.
+            alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<std::size_t> ready{0};
+        };
 
-            TaskInfo(Task t, ErrorHandler h = ErrorHandler{}) noexcept
-                : task(std::move(t))
-                , error_handler(std::move(h))
-                , state(TaskState::alive)
-            {}
+        // INFO: Every worker owns a deque of ready tasks and queued work. The owner pushes
+        // and pops from the bottom, while idle workers steal from the top of a random victim.
+        // The signal trees and `m_queued_tasks` are only used when a deque overflows or when
+        // the work originates outside of the worker pool.
+        struct alignas(atomic::internal::hardware_destructive_interference_size) LocalQueue {
+            static constexpr std::size_t task_capacity = 1024;
+            static constexpr std::size_t work_capacity = 256;
+
+            WorkStealingDeque<TaskId, task_capacity> tasks;
+            WorkStealingDeque<queue_item_t*, work_capacity> work;
+            // INFO: Only touched by the owner for victim selection.
+            std::uint64_t seed{1};
+            // INFO: Number of picks; used for aging the priority lanes.
+            std::size_t ticks{0};
+            internal::WorkerCounters stats{};
+        };
 
-            TaskInfo() noexcept = default;
-            TaskInfo(TaskInfo const&) = delete;
-            TaskInfo(TaskInfo && other) noexcept
-                : task(std::move(other.task))
-                , error_handler(std::move(other.error_handler))
-                , dep_signals(std::move(other.dep_signals))
-                , inputs(std::move(other.inputs))
-                , has_signaled(other.has_signaled)
-                , signals(other.signals.load())
-                , state(other.state.load())
-            {}
-            TaskInfo& operator=(TaskInfo const&) = delete;
-            TaskInfo& operator=(TaskInfo && other) noexcept {
-                if (this == &other) return *this;
-                using std::swap;
-                swap(task, other.task);
-                swap(inputs, other.inputs);
-                swap(has_signaled, other.has_signaled);
-                swap(error_handler, other.error_handler);
-                swap(dep_signals, other.dep_signals);
-                signals.store(other.signals.load());
-                state.store(other.state.load());
-                return *this;
+        auto local_queue() noexcept -> LocalQueue* {
+            if (WorkerPool::current() != m_pool) return nullptr;
+            return &m_local[ThisThread::pool_id()];
+        }
+
+        // INFO: Counts the task and publishes it to the worker's own deque if possible;
+        // otherwise, it falls back to the signal tree. Only the normal lane goes through
+        // the deques since the other lanes must be visible to every worker to be
+        // picked in priority order.
+        auto make_ready(TaskId id) -> void {
+            m_tasks.fetch_add(1);
+            if (m_nodes[tid_to_int(id)].lane == normal_lane) {
+                if (auto q = local_queue(); q) {
+                    m_ready.fetch_add(1);
+                    if (q->tasks.push(id)) return;
+                    m_ready.fetch_sub(1);
+                }
             }
-            ~TaskInfo() = default;
-        };
+            set_signal(id);
+        }
+
+        // INFO: Body of an item queued by `queue_work` and its variants. The callable is
+        // moved in when it's an rvalue and invoked as a non-const lvalue.
+        template <typename Fn>
+        auto make_work(Fn&& fn, Task::priority_t p) {
+            return [fn = std::forward<Fn>(fn), p, os = m_os_priority] mutable noexcept {
+                if (os) (void)ThisThread::set_priority(p);
+                std::invoke(fn);
+            };
+        }
+
+        auto submit_work(queue_item_t* item) -> void {
+            m_pending_work.fetch_add(1);
+            publish_work(item);
+        }
+
+        // INFO: Publishes a batch with a single update of the counters and one wake-up.
+        // What doesn't fit the worker's deque, or all of it off the pool, goes to
+        // the shared queue with a single `push_range`.
+        auto submit_work_n(queue_item_t* items, std::size_t n) -> void {
+            m_pending_work.fetch_add(n);
+            m_ready.fetch_add(n);
+            auto i = 0ul;
+            if (auto q = local_queue()) {
+                while (i < n && q->work.push(items + i)) ++i;
+            }
+            if (i < n) m_queued_tasks.push_range(std::views::iota(items + i, items + n));
+            m_pool->wake(n);
+        }
 
-        auto set_signal(TaskId id) -> void {
+        // INFO: The work must already be counted in `m_pending_work`.
+        auto publish_work(queue_item_t* item) -> void {
+            m_ready.fetch_add(1);
+            if (auto q = local_queue(); !q || !q->work.push(item)) {
+                m_queued_tasks.push(item);
+            }
+            m_pool->wake(1);
+        }
+
+        // INFO: `m_ready` is incremented before the task is published and decremented
+        // after it's picked so the idle workers never miss it.
+        auto set_signal(TaskId id) -> bool {
             auto idx = tid_to_int(id);
-            if (m_info[idx].state != TaskState::alive) return;
-            auto [b, p] = parse_task_id(id);
-            m_trees[b].set(p);
+            auto& node = m_nodes[idx];
+            if (node.state != TaskState::alive) return false;
+            auto [b, p] = parse_task_id(int_to_tid(position_of(idx)));
+            auto& lane = m_lanes[node.lane];
+            m_ready.fetch_add(1);
+            lane.ready.fetch_add(1);
+            lane.trees[b].set(p);
+            return true;
         }
 
         constexpr auto parse_task_id(
@@ -150,36 +349,42 @@ namespace tpl {
 
         auto on_complete(TaskId id, bool should_set_state = false) {
             auto helper = [=, this] {
-                auto& info = m_info[tid_to_int(id)];
-                if (info.state != TaskState::alive) return;
+                std::size_t ready{};
+                auto idx = tid_to_int(id);
+                auto& node = m_nodes[idx];
+                if (node.state != TaskState::alive) return ready;
 
-                if (should_set_state) {
-                    info.state = TaskState::empty;
+                if (should_set_state && !m_compiled) {
+                    release_slot(idx);
                 }
 
-                if (info.has_signaled) return;
-                info.has_signaled = true;
-
-
-                for (auto i: info.dep_signals) {
-                    auto& task = m_info[tid_to_int(i)];
-                    // INFO: Atomic exchange is not required since we before hand know
-                    // this should never go down to zero since we precomputed tasks
-                    // that will reduce the count.
-                    if (task.signals == 0) continue;
-                    task.signals.fetch_sub(1);
-                    if (task.signals == 0 && task.state == TaskState::alive) {
-                        auto [b, p] = parse_task_id(i);
-                        m_trees[b].set(p);
-                        m_tasks.fetch_add(1);
+                if (node.has_signaled) return ready;
+                node.has_signaled = true;
+
+
+                for (auto i: successors(idx)) {
+                    auto& task = m_nodes[tid_to_int(i)];
+                    if (task.signals <= 0) continue;
+                    // INFO: Only the thread that brings the count down to zero is allowed
+                    // to schedule the task.
+                    if (task.signals.fetch_sub(1) != 1) continue;
+                    if (task.state == TaskState::alive) {
+                        make_ready(i);
+                        ++ready;
+                    } else {
+                        // INFO: Cancelled but it lost the race in `on_cancelled`.
+                        release_inputs(tid_to_int(i));
                     }
                 }
+                return ready;
             };
-            helper();
+            auto ready = helper();
 
-            complete_one_task();
-            m_pool.waiter.notify_one();
             m_last_processed_task.store(id);
+            complete_one_task();
+            // INFO: The calling worker picks one of them itself.
+            if (ready != 0 && local_queue()) --ready;
+            m_pool->wake(ready);
         }
 
         auto on_failure(TaskId id) {
@@ -189,47 +394,462 @@ namespace tpl {
 
         auto on_reschedule(TaskId id) {
             (void)id;
-            m_pool.waiter.notify_one();
         }
 
-        auto build() -> std::expected<void, SchedulerError> {
-            auto sz = m_trees.size();
-            for (auto i = 0ul; i < sz; ++i) m_trees[i].clear();
-
-            // 1. find incoming edges
-            // Now we need to find nodes that do not have incoming edges
-            std::vector<std::size_t> in_edges(m_info.size(), 0);
-            m_info.for_each([&in_edges](auto& info) {
-                // Need to consider both dead and alive
-                if (info.state == TaskState::empty) return;
-                for (auto dep: info.dep_signals) in_edges[tid_to_int(dep)]++;
+        // INFO: Runs on the timer or reactor thread. A task that was cancelled while it
+        // waited is still counted in `m_tasks`, so it's failed here like in `execute`.
+        auto on_resume(TaskId id, std::size_t epoch) noexcept -> void {
+            if (epoch != 0 && !claim_parked(tid_to_int(id), epoch)) return;
+            if (set_signal(id)) {
+                m_pool->wake(1);
+                return;
+            }
+            release_inputs(tid_to_int(id));
+            on_failure(id);
+        }
+
+        auto claim_parked(std::size_t idx, std::size_t epoch) noexcept -> bool {
+            return m_parked[idx].epoch.compare_exchange_strong(epoch, 0);
+        }
+
+        // INFO: Marks the task as parked before its waker is registered and returns the
+        // epoch for the waker. Once the deadline has passed it returns zero instead and
+        // the task is signalled again, so `execute` cancels it.
+        auto park_slot(std::size_t idx, int fd) noexcept -> std::size_t {
+            auto const epoch = m_epoch.load();
+            auto& p = m_parked[idx];
+            p.fd = fd;
+            p.epoch.store(epoch);
+            if (!m_expired.load()) return epoch;
+            // NOTE: Otherwise `on_deadline` has claimed it and resumes it.
+            if (claim_parked(idx, epoch)) set_signal(int_to_tid(idx));
+            return 0;
+        }
+
+        // INFO: Runs on the timer thread once the deadline of `run` has passed. Tasks
+        // parked on the timer wheel or the reactor are resumed right away, and
+        // `execute` cancels them instead of running them.
+        auto on_deadline(std::size_t epoch) noexcept -> void {
+            // NOTE: Held until the sweep is over, so `run` can't return in the middle of it.
+            std::lock_guard lock(m_deadline_mutex);
+            if (!m_is_running || m_epoch.load() != epoch) return;
+            m_expired.store(true, std::memory_order_relaxed);
+            for (auto i = 0ul; i < m_nodes.size(); ++i) {
+                if (!claim_parked(i, epoch)) continue;
+                // INFO: Frees the slot of the reactor; the waker it runs has lost the claim.
+                if (m_parked[i].fd != -1) (void)m_reactor.unwatch(m_parked[i].fd);
+                on_resume(int_to_tid(i), 0);
+            }
+        }
+
+        // INFO: Counting sort of the edges into compressed rows; `row[i]..row[i + 1]`
+        // is the range of `values` that belongs to slot `i`. It keeps the order of the edges.
+        template <typename T, typename Key, typename Value>
+        static auto build_rows(
+            std::size_t n,
+            std::span<edge_t const> edges,
+            Key&& key,
+            Value&& value,
+            std::vector<slot_t>& row,
+            std::vector<T>& values
+        ) -> void {
+            row.assign(n + 1, 0);
+            for (auto const& e: edges) ++row[key(e) + 1];
+            std::partial_sum(row.begin(), row.end(), row.begin());
+            values.resize(edges.size());
+            std::vector<slot_t> cursor(row.begin(), row.end() - 1);
+            for (auto k = 0ul; k < edges.size(); ++k) {
+                values[cursor[key(edges[k])]++] = value(edges[k], k);
+            }
+        }
+
+        auto successors(std::size_t idx) noexcept -> std::span<TaskId> {
+            if (idx + 1 >= m_succ_row.size()) return {};
+            return std::span(m_succ).subspan(m_succ_row[idx], m_succ_row[idx + 1] - m_succ_row[idx]);
+        }
+
+        auto inputs_of(std::size_t idx) noexcept -> std::span<input_t> {
+            if (idx + 1 >= m_input_row.size()) return {};
+            return std::span(m_inputs).subspan(m_input_row[idx], m_input_row[idx + 1] - m_input_row[idx]);
+        }
+
+        // INFO: Released slots keep their edges until the slot is reused; drop them
+        // before that happens.
+        auto purge_edges() -> void {
+            auto const n = m_nodes.size();
+            std::erase_if(m_edges, [this, n](edge_t e) {
+                return e.from >= n || e.to >= n ||
+                    m_nodes[e.from].state == TaskState::empty ||
+                    m_nodes[e.to].state == TaskState::empty;
             });
+        }
+
+        // INFO: Validates the graph using Kahn's algorithm, finds the roots and marks
+        // the inputs that can be moved out of the value store instead of being cloned.
+        // It runs in O(V + E), drops duplicated edges so `deps_on` can append them
+        // blindly and builds the successor and input rows.
+        auto analyze() -> std::expected<void, SchedulerError> {
+            auto const n = m_nodes.size();
+            m_roots.clear();
+            m_cycle.clear();
+            m_order.clear();
+            m_stale_edges.store(false, std::memory_order_relaxed);
+
+            // 1. drop duplicated edges while keeping the insertion order since it's
+            // the order of the inputs. Edges to different ports of the same task
+            // are distinct inputs; they're rare so they're deduplicated by sorting.
+            // Need to consider both dead and alive since dead task still blocks its dependents.
+            purge_edges();
+            {
+                std::vector<slot_t> row;
+                std::vector<slot_t> by_source;
+                build_rows(n, m_edges, [](edge_t e) { return e.from; }, [](edge_t, std::size_t k) {
+                    return static_cast<slot_t>(k);
+                }, row, by_source);
+
+                std::vector<std::size_t> stamp(n, npos);
+                std::vector<bool> keep(m_edges.size(), true);
+                std::vector<std::pair<edge_t, std::size_t>> port_edges;
+                for (auto i = 0ul; i < n; ++i) {
+                    for (auto k = row[i]; k < row[i + 1]; ++k) {
+                        auto e = by_source[k];
+                        if (is_port_id(m_edges[e].key)) {
+                            port_edges.emplace_back(m_edges[e], e);
+                            continue;
+                        }
+                        auto to = m_edges[e].to;
+                        if (stamp[to] == i) keep[e] = false;
+                        stamp[to] = i;
+                    }
+                }
+                std::ranges::sort(port_edges);
+                for (auto k = 1ul; k < port_edges.size(); ++k) {
+                    if (port_edges[k].first == port_edges[k - 1].first) keep[port_edges[k].second] = false;
+                }
+                auto k = 0ul;
+                std::erase_if(m_edges, [&keep, &k](edge_t) { return !keep[k++]; });
+            }
+
+            build_rows(n, m_edges, [](edge_t e) { return e.from; }, [](edge_t e, std::size_t) {
+                return int_to_tid(e.to);
+            }, m_succ_row, m_succ);
+            build_rows(n, m_edges, [](edge_t e) { return e.to; }, [](edge_t e, std::size_t) {
+                return input_t{ e.key, false };
+            }, m_input_row, m_inputs);
+
+            // 2. topological order; whatever is not visited is part of a cycle or
+            // depends on one.
+            std::vector<std::size_t> degree(n);
+            std::size_t nodes{};
+            std::vector<std::size_t> order;
+            for (auto i = 0ul; i < n; ++i) {
+                if (m_nodes[i].state == TaskState::empty) continue;
+                ++nodes;
+                degree[i] = m_input_row[i + 1] - m_input_row[i];
+                if (degree[i] == 0) order.push_back(i);
+            }
+            order.reserve(nodes);
+            for (auto k = 0ul; k < order.size(); ++k) {
+                for (auto dep: successors(order[k])) {
+                    auto d = tid_to_int(dep);
+                    if (--degree[d] == 0) order.push_back(d);
+                }
+            }
 
-            // 2. queue tasks if there is no deps
-            for (auto i = 0ul; i < in_edges.size(); ++i) {
-                auto& info = m_info[i];
-                if (info.state != TaskState::alive) continue;
-                if (in_edges[i] == 0) {
-                    set_signal(int_to_tid(i));
-                    m_tasks.fetch_add(1);
+            if (order.size() != nodes) {
+                collect_cycle(degree);
+                return std::unexpected(SchedulerError::cycle_found);
+            }
+            m_order = std::move(order);
+
+            // 3. reset signals and collect tasks that do not have deps
+            for (auto i = 0ul; i < n; ++i) {
+                auto& node = m_nodes[i];
+                if (node.state != TaskState::alive) continue;
+                auto in_edges = m_input_row[i + 1] - m_input_row[i];
+                node.signals.store(static_cast<std::int32_t>(in_edges), std::memory_order_relaxed);
+                if (in_edges == 0) {
+                    m_roots.push_back(int_to_tid(i));
                 }
             }
 
-            // 3. set consumable output values
-            std::fill(in_edges.begin(), in_edges.end(), 0);
-            auto& freq = in_edges;
-            m_info.for_each([&freq](auto& info, std::size_t i) {
-                if (info.state != TaskState::alive) return;
-                freq[i] += info.dep_signals.size();
+            // 4. a value with a single consumer is moved into it instead of being shared;
+            // either way it's freed as soon as its last consumer finishes. Every port
+            // is counted on its own.
+            std::vector<std::size_t> freq(n, 0);
+            std::vector<std::size_t> port_freq(m_port_owner.size(), 0);
+            auto consumers = [&freq, &port_freq](TaskId key) -> std::size_t& {
+                return is_port_id(key) ? port_freq[tid_to_port(key)] : freq[tid_to_int(key)];
+            };
+            for (auto i = 0ul; i < n; ++i) {
+                if (m_nodes[i].state != TaskState::alive) continue;
+                for (auto [key, _]: inputs_of(i)) ++consumers(key);
+            }
+
+            for (auto i = 0ul; i < n; ++i) {
+                m_store.set_readers(int_to_tid(i), static_cast<std::uint32_t>(freq[i]));
+            }
+            for (auto p = 0ul; p < port_freq.size(); ++p) {
+                m_store.set_readers(port_to_tid(p), static_cast<std::uint32_t>(port_freq[p]));
+            }
+
+            for (auto i = 0ul; i < n; ++i) {
+                if (m_nodes[i].state != TaskState::alive) continue;
+                for (auto& in: inputs_of(i)) {
+                    in.second = (consumers(in.first) == 1);
+                }
+            }
+            return {};
+        }
+
+        // INFO: Nodes left with incoming edges after Kahn's pass are either on a cycle
+        // or downstream of one. Peel off the nodes that cannot reach back into the
+        // remaining set; whatever is left are the cycle members.
+        auto collect_cycle(std::vector<std::size_t>& remaining) -> void {
+            auto const n = m_nodes.size();
+            std::vector<std::size_t> out(n, 0);
+            std::vector<std::size_t> stack;
+            for (auto i = 0ul; i < n; ++i) {
+                if (remaining[i] == 0) continue;
+                for (auto dep: successors(i)) {
+                    out[i] += (remaining[tid_to_int(dep)] != 0);
+                }
+                if (out[i] == 0) stack.push_back(i);
+            }
+
+            while (!stack.empty()) {
+                auto v = stack.back();
+                stack.pop_back();
+                remaining[v] = 0;
+                for (auto [p, _]: inputs_of(v)) {
+                    auto pi = producer_of(p);
+                    if (pi >= n || remaining[pi] == 0) continue;
+                    if (--out[pi] == 0) stack.push_back(pi);
+                }
+            }
+
+            for (auto i = 0ul; i < n; ++i) {
+                if (remaining[i] != 0) m_cycle.push_back(int_to_tid(i));
+            }
+        }
+
+        // INFO: Appends the edge without validating the whole graph; duplicates and
+        // cycles are handled by `analyze` during `build`/`compile`. If
+        // `TPL_VALIDATE_EDGES` is defined, every edge is checked as it's added.
+        auto link(TaskId from, TaskId to) -> std::expected<void, SchedulerError> {
+            invalidate();
+            assert(!is_port_id(to) && "A port cannot depend on a task");
+            auto key = from;
+            if (is_port_id(from)) {
+                auto owner = producer_of(from);
+                if (owner == npos) return {};
+                from = int_to_tid(owner);
+            }
+            if (from == to) {
+                return std::unexpected(SchedulerError::cycle_found);
+            }
+
+            auto from_idx = tid_to_int(from);
+            auto to_idx = tid_to_int(to);
+            if (m_nodes.size() <= from_idx || m_nodes.size() <= to_idx) return {};
+            if (m_nodes[from_idx].state != TaskState::alive) return {};
+
+            #ifdef TPL_VALIDATE_EDGES
+            if (reaches(to_idx, from_idx)) {
+                return std::unexpected(SchedulerError::cycle_found);
+            }
+            #endif
+
+            m_edges.push_back(edge_t{
+                .from = static_cast<slot_t>(from_idx),
+                .to = static_cast<slot_t>(to_idx),
+                .key = key
             });
+            return {};
+        }
+
+        // INFO: Slot of the task that produces `key`, or `npos` for a stale port.
+        auto producer_of(TaskId key) const noexcept -> std::size_t {
+            if (!is_port_id(key)) return tid_to_int(key);
+            auto p = tid_to_port(key);
+            if (p >= m_port_owner.size() || m_port_owner[p] == no_slot) return npos;
+            return m_port_owner[p];
+        }
+
+        // INFO: Port ids are handed out once per slot and reused with it, so the
+        // value store only grows when a slot needs more ports than it had.
+        auto assign_ports(std::size_t idx, std::size_t count) -> void {
+            auto& range = m_ports[idx];
+            if (range.reserved < count) {
+                for (auto k = 0ul; k < range.reserved; ++k) m_port_owner[range.base + k] = no_slot;
+                // NOTE: The last id would be `invalid_task_id` once the port bit is set.
+                assert(m_port_owner.size() + count <= max_tasks && "too many ports");
+                range.base = static_cast<slot_t>(m_port_owner.size());
+                range.reserved = static_cast<slot_t>(count);
+                m_port_owner.resize(m_port_owner.size() + count, no_slot);
+                m_store.resize_ports(m_port_owner.size());
+            }
+            range.count = static_cast<slot_t>(count);
+            for (auto k = 0ul; k < count; ++k) m_port_owner[range.base + k] = static_cast<slot_t>(idx);
+        }
+
+        auto port_id(TaskId id, std::size_t port) const noexcept -> TaskId {
+            auto const& range = m_ports[tid_to_int(id)];
+            assert(port < range.count);
+            return port_to_tid(range.base + port);
+        }
 
-            m_info.for_each([&freq](TaskInfo& info) {
-                if (info.state != TaskState::alive) return;
-                for (auto j = 0ul; j < info.inputs.size(); ++j) {
-                    auto& in = info.inputs[j];
-                    in.second = (freq[tid_to_int(in.first)] == 0);
+        #ifdef TPL_VALIDATE_EDGES
+        auto reaches(std::size_t from, std::size_t to) const -> bool {
+            auto const n = m_nodes.size();
+            std::vector<slot_t> row;
+            std::vector<slot_t> adj;
+            build_rows(n, m_edges, [](edge_t e) { return e.from; }, [](edge_t e, std::size_t) {
+                return e.to;
+            }, row, adj);
+
+            std::vector<bool> visited(n, false);
+            std::vector<std::size_t> stack{ from };
+            visited[from] = true;
+            while (!stack.empty()) {
+                auto v = stack.back();
+                stack.pop_back();
+                if (v == to) return true;
+                for (auto k = row[v]; k < row[v + 1]; ++k) {
+                    auto d = adj[k];
+                    if (d >= n || visited[d]) continue;
+                    visited[d] = true;
+                    stack.push_back(d);
                 }
+            }
+            return false;
+        }
+        #endif
+
+        // INFO: Computes the bottom level (the longest path to a sink) of every task,
+        // weighted by the measured run times, and maps the slots onto the signal trees
+        // in the decreasing order of it. Since the trees select the leftmost signal
+        // first, tasks on the critical path are picked before the side branches.
+        // Successors are also ordered so that the most critical one is pushed last
+        // onto the worker's deque and popped first. Tasks that have never run weigh
+        // as much as the average measured task.
+        auto plan() -> void {
+            auto const n = m_nodes.size();
+            std::uint64_t total{};
+            std::size_t measured{};
+            for (auto i: m_order) {
+                auto e = m_estimates[i];
+                total += e;
+                measured += (e != 0);
+            }
+            auto const fallback = measured == 0 ? std::uint64_t{1} : std::max(total / measured, std::uint64_t{1});
+
+            auto& level = m_level;
+            level.assign(n, 0);
+            for (auto k = m_order.size(); k > 0; --k) {
+                auto i = m_order[k - 1];
+                auto succ = successors(i);
+                std::uint64_t longest{};
+                for (auto dep: succ) {
+                    longest = std::max(longest, level[tid_to_int(dep)]);
+                }
+                auto estimate = m_estimates[i];
+                level[i] = longest + (estimate == 0 ? fallback : estimate);
+                std::ranges::sort(succ, {}, [&level](TaskId dep) {
+                    return level[tid_to_int(dep)];
+                });
+            }
+
+            m_by_rank.resize(n);
+            std::iota(m_by_rank.begin(), m_by_rank.end(), std::size_t{0});
+            std::ranges::stable_sort(m_by_rank, std::ranges::greater{}, [&level](std::size_t i) {
+                return level[i];
             });
+            m_rank.resize(n);
+            for (auto k = 0ul; k < n; ++k) m_rank[m_by_rank[k]] = k;
+            m_planned_estimates.resize(n);
+            for (auto i: m_order) m_planned_estimates[i] = m_estimates[i];
+
+            for (auto l = 0ul; l < lanes; ++l) {
+                auto& trees = m_lanes[l].trees;
+                if (l != normal_lane && trees.empty()) continue;
+                trees.resize(blocks_for(n));
+            }
+        }
+
+        // INFO: True once a run time moved `replan_ratio` times away from the one
+        // `plan` ranked the task with, or a task got its first measurement.
+        auto estimates_drifted() const noexcept -> bool {
+            for (auto i: m_order) {
+                auto planned = m_planned_estimates[i];
+                auto estimate = m_estimates[i];
+                if (planned == estimate) continue;
+                if (planned == 0 || estimate == 0) return true;
+                if (estimate / replan_ratio >= planned || planned / replan_ratio >= estimate) return true;
+            }
+            return false;
+        }
+
+        // INFO: Slots added after `plan` keep their own position; it cannot collide
+        // since the planned positions are a permutation of the planned slots.
+        auto position_of(std::size_t slot) const noexcept -> std::size_t {
+            return slot < m_rank.size() ? m_rank[slot] : slot;
+        }
+
+        auto slot_at(std::size_t pos) const noexcept -> std::size_t {
+            return pos < m_by_rank.size() ? m_by_rank[pos] : pos;
+        }
+
+        // INFO: Order independent hash of the tasks and the distinct edges that is used
+        // to match a saved profile with the graph.
+        auto fingerprint() const -> std::uint64_t {
+            auto const n = m_nodes.size();
+            auto mix = [](std::uint64_t x) {
+                x += 0x9e3779b97f4a7c15;
+                x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+                x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+                return x ^ (x >> 31);
+            };
+            auto alive = [this, n](std::size_t i) {
+                return i < n && m_nodes[i].state != TaskState::empty;
+            };
+
+            std::uint64_t hash = mix(n);
+            for (auto i = 0ul; i < n; ++i) {
+                if (alive(i)) hash += mix(i);
+            }
+
+            auto edges = m_edges;
+            std::erase_if(edges, [&alive](edge_t e) { return !alive(e.from) || !alive(e.to); });
+            std::ranges::sort(edges);
+            auto [first, last] = std::ranges::unique(edges);
+            edges.erase(first, last);
+            for (auto [from, to, key]: edges) {
+                auto h = mix((static_cast<std::uint64_t>(from) << 32) ^ mix(to));
+                if (is_port_id(key)) h = mix(h ^ static_cast<std::uint64_t>(key));
+                hash += h;
+            }
+            return hash;
+        }
+
+        auto seed_roots() -> void {
+            for (auto id: m_roots) {
+                set_signal(id);
+                m_tasks.fetch_add(1);
+            }
+        }
+
+        auto build() -> std::expected<void, SchedulerError> {
+            for (auto& lane: m_lanes) {
+                auto sz = lane.trees.size();
+                for (auto i = 0ul; i < sz; ++i) lane.trees[i].clear();
+                lane.ready.store(0);
+            }
+
+            auto res = analyze();
+            if (!res) return res;
+            plan();
+            seed_roots();
 
             if (empty()) {
                 return std::unexpected(SchedulerError::no_root_task);
@@ -237,8 +857,98 @@ namespace tpl {
             return {};
         }
 
+        // INFO: Brings a compiled graph back to the state it was in right after `compile`.
+        // Slots are never released while compiled so only the counters need to be restored;
+        // the plan made by `compile` is kept until the run times drift away from it.
+        auto restore() -> std::expected<void, SchedulerError> {
+            m_store.clear();
+            if (estimates_drifted()) plan();
+            m_nodes.for_each([](TaskNode& node) {
+                if (node.state == TaskState::empty) return;
+                node.signals.store(node.initial_signals, std::memory_order_relaxed);
+                node.has_signaled = false;
+                node.state.store(TaskState::alive, std::memory_order_relaxed);
+            });
+            #ifdef __cpp_exceptions
+            m_bodies.for_each([](TaskBody& body) {
+                body.expception_ptr = nullptr;
+            });
+            #endif
+
+            seed_roots();
+            return {};
+        }
+
+        auto invalidate() noexcept -> void {
+            m_compiled = false;
+        }
+
+        // INFO: Compiled graphs keep the slot alive so it can be restored for the next run;
+        // stopped tasks are only marked dead for the current run. Returns false if the
+        // task was already retired.
+        auto retire_slot(std::size_t idx) noexcept -> bool {
+            if (m_compiled) {
+                auto expected = TaskState::alive;
+                return m_nodes[idx].state.compare_exchange_strong(expected, TaskState::dead);
+            }
+            return release_slot(idx);
+        }
+
+        // INFO: Removes the value of the task and of its ports.
+        auto drop_values(std::size_t idx) noexcept -> void {
+            m_store.remove(int_to_tid(idx));
+            auto const& ports = m_ports[idx];
+            for (auto k = 0ul; k < ports.count; ++k) {
+                m_store.remove(port_to_tid(ports.base + k));
+            }
+        }
+
+        // INFO: Called once for every task retired by a cancellation. A task still
+        // waiting for its inputs will never run, so it gives up its share of them
+        // here; the values of the producers that are still running are freed once
+        // they are published. A ready or running task does it in `execute`. Only a
+        // sink's own value can be dropped since consumers of other values may still
+        // be reading them.
+        auto on_cancelled(std::size_t idx) noexcept -> void {
+            auto& signals = m_nodes[idx].signals;
+            auto left = signals.load();
+            // NOTE: Races with the decrements of `on_complete`; the one that takes the
+            // count out of the positive range releases the inputs. A negative count
+            // keeps the task from ever becoming ready.
+            while (left > 0 && !signals.compare_exchange_weak(left, -1));
+            if (left > 0) release_inputs(idx);
+            if (successors(idx).empty()) drop_values(idx);
+        }
+
+        auto release_inputs(std::size_t idx) noexcept -> void {
+            for (auto [key, _]: inputs_of(idx)) m_store.release_reader(key);
+        }
+
+        // INFO: Walks the successors in one pass; a task is only visited by the
+        // cancellation that retires it, so it costs O(V + E) however often it's called.
+        // Tasks that are already ready are skipped by `execute` when picked.
+        auto cancel_successors(std::size_t idx) -> void {
+            std::vector<std::size_t> stack{ idx };
+            while (!stack.empty()) {
+                auto i = stack.back();
+                stack.pop_back();
+                for (auto dep: successors(i)) {
+                    auto d = tid_to_int(dep);
+                    if (!retire_slot(d)) continue;
+                    on_cancelled(d);
+                    stack.push_back(d);
+                }
+            }
+        }
+
+        auto cancel_task(std::size_t idx) -> void {
+            if (idx >= m_nodes.size() || !retire_slot(idx)) return;
+            on_cancelled(idx);
+            cancel_successors(idx);
+        }
+
         auto set_error_handler(TaskId id, ErrorHandler&& handler) noexcept {
-            m_info[tid_to_int(id)].error_handler = std::move(handler);
+            m_bodies[tid_to_int(id)].error_handler = std::move(handler);
         }
     public:
         struct DependencyTracker {
@@ -250,9 +960,9 @@ namespace tpl {
             ) -> std::expected<void, SchedulerError>;
 
             template <typename... Ts>
-                requires ((std::same_as<Ts, DependencyTracker> && ...) && (sizeof...(Ts) > 0))
+                requires ((std::derived_from<Ts, DependencyTracker> && ...) && (sizeof...(Ts) > 0))
             auto deps_on(Ts... ids) -> std::expected<void, SchedulerError> {
-                std::array tmp { ids... };
+                std::array<DependencyTracker, sizeof...(Ts)> tmp { ids... };
                 return deps_on(tmp);
             }
 
@@ -261,32 +971,102 @@ namespace tpl {
             }
         };
 
+        // INFO: One output of a task returning `Ports`; a dependent only receives that element.
+        template <typename T>
+        struct PortTracker: DependencyTracker {
+            using result_type = T;
+        };
+
+        // INFO: Tracker that remembers the type of the task's result, so
+        // `TaskToken::arg(tracker)` and `get_result(tracker)` need no type argument.
+        template <typename R>
+        struct TypedTracker: DependencyTracker {
+            using result_type = R;
+
+            template <std::size_t I>
+                requires (internal::is_ports_v<R> && I < std::tuple_size_v<R>)
+            auto port() const noexcept -> PortTracker<std::tuple_element_t<I, R>> {
+                return { { .id = parent->port_id(id, I), .parent = parent } };
+            }
+        };
+
+        // INFO: `to` runs after `from` completes and receives its value as an input.
+        auto add_edge(
+            DependencyTracker from,
+            DependencyTracker to
+        ) -> std::expected<void, SchedulerError> {
+            assert(from.parent == this && to.parent == this);
+            return link(from.id, to.id);
+        }
+
+        // INFO: Bulk insertion of `(from, to)` pairs; the graph is validated once
+        // during `run` or `compile`.
+        template <std::ranges::input_range Edges>
+            requires requires (std::ranges::range_reference_t<Edges> e) {
+                { e.first } -> std::convertible_to<DependencyTracker>;
+                { e.second } -> std::convertible_to<DependencyTracker>;
+            }
+        auto add_edges(
+            Edges&& edges
+        ) -> std::expected<void, SchedulerError> {
+            for (auto const& [from, to]: edges) {
+                auto res = add_edge(from, to);
+                if (!res) return res;
+            }
+            return {};
+        }
+
+        // INFO: Members of the cycle found by the last `run` or `compile`.
+        auto cycle() const noexcept -> std::span<TaskId const> {
+            return m_cycle;
+        }
+
         auto add_task(
             Task t,
             ErrorHandler handler
         ) -> DependencyTracker {
-            ensure_space_for(m_info.size() + 1);
+            invalidate();
+            if (m_stale_edges.exchange(false, std::memory_order_relaxed)) purge_edges();
+            auto lane = priority_lane(t.priority());
+            auto i = acquire_slot();
+            m_bodies[i] = TaskBody{ .task = std::move(t), .error_handler = std::move(handler) };
+            m_estimates[i] = 0;
+            m_ports[i].count = 0;
+            auto& node = m_nodes[i];
+            node.signals.store(0, std::memory_order_relaxed);
+            node.has_signaled = false;
+            node.lane = static_cast<std::uint8_t>(lane);
+            node.initial_signals = 0;
+            node.state.store(TaskState::alive);
+            m_lanes[lane].trees.resize(blocks_for(m_nodes.size()));
+            return { .id = int_to_tid(i), .parent = this };
+        }
 
-            for (auto i = 0ul; auto& info: m_info) {
-                if (info.state == TaskState::alive) {
-                    ++i;
-                    continue;
-                }
-                info = TaskInfo(std::move(t), std::move(handler));
-                return { .id = int_to_tid(i), .parent = this };
+        // INFO: Pre-sizes the task slots, signal trees and value store so the
+        // following `add_task` calls do not grow them one by one. At most
+        // `max_tasks` slots can exist.
+        auto reserve(std::size_t n) -> void {
+            assert(n <= max_tasks && "a slot would collide with the port ids");
+            auto old_size = m_nodes.size();
+            if (n <= old_size) return;
+            ensure_space_for(n);
+            // Pushed in reverse so that the slots are handed out in ascending order.
+            for (auto i = n; i > old_size; --i) {
+                push_free_slot(i - 1);
             }
-            std::unreachable();
         }
 
+        // INFO: A task returning `Ports<Ts...>` gets one output per element; see
+        // `TypedTracker::port`.
         template <typename Fn>
         constexpr auto add_task(
             Fn&& fn,
             Task::priority_t p = Task::priority_t::normal
-        ) -> DependencyTracker {
-            return add_task(
-                Task(std::forward<Fn>(fn), p),
+        ) -> TypedTracker<internal::task_result_t<Fn>> {
+            return with_ports<internal::task_result_t<Fn>>(add_task(
+                Task(std::forward<Fn>(fn), p, m_alloc.get()),
                 ErrorHandler()
-            );
+            ));
         }
 
         template <typename Fn, typename EFn>
@@ -294,11 +1074,11 @@ namespace tpl {
             Fn&& fn,
             EFn&& e_fn,
             Task::priority_t p = Task::priority_t::normal
-        ) -> DependencyTracker {
-            return add_task(
-                Task(std::forward<Fn>(fn), p),
-                ErrorHandler(std::forward<EFn>(e_fn))
-            );
+        ) -> TypedTracker<internal::task_result_t<Fn>> {
+            return with_ports<internal::task_result_t<Fn>>(add_task(
+                Task(std::forward<Fn>(fn), p, m_alloc.get()),
+                ErrorHandler(std::forward<EFn>(e_fn), m_alloc.get())
+            ));
         }
 
         template <typename Fn>
@@ -309,20 +1089,21 @@ namespace tpl {
         ) -> Awaiter<decltype(std::invoke(fn))> {
             using ret_t = decltype(std::invoke(fn));
             auto task = m_alloc->alloc<queue_item_t>();
-            Awaiter<ret_t> await;
+            auto state = internal::AwaiterRef<ret_t>{};
+            auto await = Awaiter<ret_t>(state.share(), this);
             new(task) queue_item_t(
-                [wrapper = await.m_data, fn = std::forward<Fn>(fn), p] noexcept {
-                    [[maybe_unused]] auto is_priority_set = ThisThread::set_priority(p);
-                    assert(is_priority_set == true);
+                [wrapper = std::move(state), fn = std::forward<Fn>(fn), p, os = m_os_priority] mutable noexcept {
+                    if (os) (void)ThisThread::set_priority(p);
                     if constexpr (std::is_void_v<ret_t>) {
                         std::invoke(fn);
                         wrapper->notify_value();
                     } else {
                         wrapper->notify_value(std::invoke(fn));
                     }
-                }
+                },
+                m_alloc.get()
             );
-            m_queued_tasks.push(task);
+            submit_work(task);
             return await;
         }
 
@@ -333,58 +1114,322 @@ namespace tpl {
             Task::priority_t p = Task::priority_t::normal
         ) -> void {
             auto task = m_alloc->alloc<queue_item_t>();
-            new(task) queue_item_t(
-                [fn = std::forward<Fn>(fn), p] noexcept {
-                    [[maybe_unused]] auto is_priority_set = ThisThread::set_priority(p);
-                    assert(is_priority_set == true);
-                    std::invoke(fn);
+            new(task) queue_item_t(make_work(std::forward<Fn>(fn), p), m_alloc.get());
+            submit_work(task);
+        }
+
+        // INFO: Queues every callable of the range with one allocation for all the
+        // items, one update of the counters and a single wake-up. The callables are
+        // moved out of an rvalue range that owns them and copied otherwise.
+        template <std::ranges::sized_range R>
+            requires (std::is_nothrow_invocable_r_v<void, std::ranges::range_value_t<R>&>)
+        auto queue_work_bulk(
+            R&& fns,
+            Task::priority_t p = Task::priority_t::normal
+        ) -> void {
+            using fn_t = std::ranges::range_value_t<R>;
+            auto n = static_cast<std::size_t>(std::ranges::size(fns));
+            if (n == 0) return;
+            auto items = m_alloc->alloc_n<queue_item_t>(n);
+            auto it = std::ranges::begin(fns);
+            for (auto i = 0ul; i < n; ++i, ++it) {
+                // NOTE: A view borrows the callables, so they're copied out of it.
+                if constexpr (std::is_lvalue_reference_v<R> || std::ranges::borrowed_range<R>) {
+                    new(items + i) queue_item_t(make_work(fn_t(*it), p), m_alloc.get());
+                } else {
+                    new(items + i) queue_item_t(make_work(fn_t(std::ranges::iter_move(it)), p), m_alloc.get());
                 }
-            );
-            m_queued_tasks.push(task);
+            }
+            submit_work_n(items, n);
+        }
+
+        // INFO: Queues `fn(i)` for every `i` in `[0, n)` like `queue_work_bulk`. The
+        // items share a single copy of `fn`, which is destroyed by the last one.
+        template <typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, std::decay_t<Fn> const&, std::size_t>)
+        auto submit_n(
+            std::size_t n,
+            Fn&& fn,
+            Task::priority_t p = Task::priority_t::normal
+        ) -> void {
+            if (n == 0) return;
+            struct Shared {
+                std::decay_t<Fn> fn;
+                std::atomic<std::size_t> left;
+            };
+            auto shared = m_alloc->alloc<Shared>();
+            new(shared) Shared{ std::forward<Fn>(fn), n };
+            auto items = m_alloc->alloc_n<queue_item_t>(n);
+            for (auto i = 0ul; i < n; ++i) {
+                new(items + i) queue_item_t(
+                    [this, shared, i, p, os = m_os_priority] noexcept {
+                        if (os) (void)ThisThread::set_priority(p);
+                        std::invoke(std::as_const(shared->fn), i);
+                        if (shared->left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                            std::destroy_at(shared);
+                            m_alloc->dealloc(shared);
+                        }
+                    },
+                    m_alloc.get()
+                );
+            }
+            submit_work_n(items, n);
+        }
+
+        // INFO: Counts as pending work right away, so `run` waits for it to fire.
+        template <typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, Fn>)
+        auto queue_work_at(
+            std::chrono::steady_clock::time_point tp,
+            Fn&& fn,
+            Task::priority_t p = Task::priority_t::normal
+        ) -> void {
+            auto task = m_alloc->alloc<queue_item_t>();
+            new(task) queue_item_t(make_work(std::forward<Fn>(fn), p), m_alloc.get());
+            m_pending_work.fetch_add(1);
+            m_timers.schedule_at(tp, [this, task] noexcept {
+                publish_work(task);
+            });
+        }
+
+        template <typename Rep, typename Period, typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, Fn>)
+        auto queue_work_after(
+            std::chrono::duration<Rep, Period> delay,
+            Fn&& fn,
+            Task::priority_t p = Task::priority_t::normal
+        ) -> void {
+            queue_work_at(std::chrono::steady_clock::now() + delay, std::forward<Fn>(fn), p);
+        }
+
+        // INFO: Wakes up the task waiting on the descriptor; it has to be called
+        // before the descriptor is closed. See `TaskToken::wait_readable`.
+        auto unwatch(int fd) -> bool {
+            return m_reactor.unwatch(fd);
         }
 
         auto empty() const noexcept -> bool {
-            auto sz = m_trees.size();
-            for (auto i = 0ul; i < sz; ++i) {
-                auto& t = m_trees[i];
-                if (!t.empty()) return false;
+            for (auto const& lane: m_lanes) {
+                if (lane.ready.load() != 0) return false;
             }
             return true;
         }
 
+        // INFO: The task priority only affects the order in which ready tasks are
+        // picked. If enabled, workers also change their OS thread priority to match
+        // the task; the syscall is skipped when the worker already runs at it.
+        auto set_os_priority(bool enable) noexcept -> void {
+            m_os_priority = enable;
+        }
+
+        constexpr auto os_priority() const noexcept -> bool {
+            return m_os_priority;
+        }
+
+        // INFO: Snapshots the topology, the roots and the initial signal counts so that
+        // the following `run` calls only restore the counters and re-seed the roots instead
+        // of rebuilding the graph. Adding tasks, dependencies or calling `reset` invalidates
+        // the snapshot and the next `run` falls back to a normal build. The tasks are
+        // ranked here with the run times measured so far, and again before a run once
+        // the measurements drift away from them (see `replan_ratio`); loading a
+        // profile re-ranks them as well.
+        auto compile() -> std::expected<void, SchedulerError> {
+            if (m_is_running) return {};
+            invalidate();
+            auto res = analyze();
+            if (!res) return res;
+            if (m_roots.empty()) {
+                return std::unexpected(SchedulerError::no_root_task);
+            }
+            plan();
+            m_nodes.for_each([](TaskNode& node) {
+                if (node.state != TaskState::alive) return;
+                node.initial_signals = node.signals.load(std::memory_order_relaxed);
+            });
+            m_compiled = true;
+            return {};
+        }
+
+        constexpr auto is_compiled() const noexcept -> bool {
+            return m_compiled;
+        }
+
+        // INFO: Writes the measured run times so that a later process building the same
+        // graph can pick the critical path from its first run. Slots of a graph that is
+        // not compiled are released as the tasks complete so it should be saved
+        // after running a compiled graph.
+        auto save_profile(std::ostream& os) const -> void {
+            auto const n = m_nodes.size();
+            auto has_estimate = [this](std::size_t i) {
+                return m_nodes[i].state != TaskState::empty && m_estimates[i] != 0;
+            };
+            std::size_t count{};
+            for (auto i = 0ul; i < n; ++i) count += has_estimate(i);
+            std::println(os, "tpl-profile 1 {} {}", fingerprint(), count);
+            for (auto i = 0ul; i < n; ++i) {
+                if (has_estimate(i)) std::println(os, "{} {}", i, m_estimates[i]);
+            }
+        }
+
+        // INFO: Loads the run times written by `save_profile`. It must be called after
+        // the graph is built, and it's rejected if the graph has changed.
+        auto load_profile(std::istream& is) -> std::expected<void, SchedulerError> {
+            if (m_is_running) return {};
+            std::string magic;
+            int version{};
+            std::uint64_t hash{};
+            std::size_t count{};
+            if (!(is >> magic >> version >> hash >> count)) {
+                return std::unexpected(SchedulerError::invalid_profile);
+            }
+            if (magic != "tpl-profile" || version != 1 || hash != fingerprint()) {
+                return std::unexpected(SchedulerError::invalid_profile);
+            }
+
+            std::vector<std::pair<std::size_t, std::uint64_t>> entries(count);
+            for (auto& [slot, estimate]: entries) {
+                if (!(is >> slot >> estimate) || slot >= m_nodes.size()) {
+                    return std::unexpected(SchedulerError::invalid_profile);
+                }
+            }
+            for (auto [slot, estimate]: entries) {
+                if (m_nodes[slot].state == TaskState::empty) continue;
+                m_estimates[slot] = estimate;
+            }
+            if (m_compiled) plan();
+            return {};
+        }
+
+        // INFO: Writes what the workers of its pool have run as Chrome trace JSON; the
+        // events are only recorded if `TPL_ENABLE_TRACE` is defined. A shared pool
+        // records the work of every scheduler attached to it.
+        auto dump_trace(std::ostream& os) const -> void {
+            m_pool->dump_trace(os);
+        }
+
+        auto clear_trace() noexcept -> void {
+            m_pool->clear_trace();
+        }
+
+        // INFO: Adds up the counters of the workers. The task and work counters only
+        // cover this scheduler, while the idle and park counters belong to the pool
+        // and cover every scheduler sharing it.
+        auto stats() const -> SchedulerStats {
+            auto res = SchedulerStats{ .workers = std::vector<WorkerStats>(m_pool->size()) };
+            for (auto i = 0ul; i < m_pool->size(); ++i) {
+                auto& w = res.workers[i];
+                w = m_local[i].stats.snapshot();
+                auto idle = m_pool->m_workers[i].stats.snapshot();
+                w.parks = idle.parks;
+                w.wakeups = idle.wakeups;
+                w.idle = idle.idle;
+                res.total += w;
+            }
+            return res;
+        }
+
+        // INFO: Clears the counters of this scheduler and its pool; it should not be
+        // called during a run. See `internal::WorkerCounters::reset`.
+        auto reset_stats() noexcept -> void {
+            for (auto i = 0ul; i < m_pool->size(); ++i) {
+                m_local[i].stats.reset();
+                m_pool->m_workers[i].stats.reset();
+            }
+        }
+
         auto reset() {
-            m_trees.clear();
-            m_info.clear();
+            invalidate();
+            m_roots.clear();
+            m_cycle.clear();
+            m_order.clear();
+            m_rank.clear();
+            m_by_rank.clear();
+            m_planned_estimates.clear();
+            for (auto& lane: m_lanes) {
+                lane.trees.clear();
+                lane.ready.store(0);
+            }
+            m_nodes.clear();
+            m_bodies.clear();
+            m_parked.clear();
+            m_estimates.clear();
+            m_ports.clear();
+            m_port_owner.clear();
+            m_edges.clear();
+            m_succ_row.clear();
+            m_succ.clear();
+            m_input_row.clear();
+            m_inputs.clear();
             m_store.clear();
+            m_free_slots.store(no_slot);
         }
 
         auto run() -> std::expected<void, SchedulerError> {
-            m_last_processed_task.store(int_to_tid(std::numeric_limits<std::size_t>::max()));
-            auto res = build();
+            return run(std::chrono::steady_clock::time_point::max());
+        }
+
+        // INFO: Tasks that have not started by `deadline` are cancelled together with
+        // everything downstream of them. Tasks waiting on the timer wheel or the reactor
+        // are cancelled at the deadline, and the ones parked on other events once they
+        // are woken up. Running tasks and queued work are not interrupted, but tasks
+        // can poll `TaskToken::is_cancelled`.
+        auto run(std::chrono::steady_clock::time_point deadline) -> std::expected<void, SchedulerError> {
+            auto const epoch = ++m_epoch;
+            m_deadline = deadline;
+            m_timed_out.store(false, std::memory_order_relaxed);
+            m_expired.store(false, std::memory_order_relaxed);
+            m_last_processed_task.store(invalid_task_id);
+            auto res = m_compiled ? restore() : build();
             if (!res) return res;
             if (m_tasks == 0) return {};
             m_is_running = true;
+            // NOTE: The timer outlives a run that finishes early; the epoch tells it apart.
+            if (deadline != std::chrono::steady_clock::time_point::max()) {
+                m_timers.schedule_at(deadline, [this, epoch] noexcept { on_deadline(epoch); });
+            }
 
-            m_pool.waiter.notify_all();
-            m_waiter.wait([this] {
-                return m_tasks == 0 && m_pool.is_running() && m_queued_tasks.empty();
+            auto slot = m_pool->attach(*this);
+            m_pool->wake(m_ready.load());
+            m_done.wait([this] {
+                return m_tasks == 0 && m_pending_work == 0;
             });
-            m_is_running = false;
+            {
+                std::lock_guard lock(m_deadline_mutex);
+                m_is_running = false;
+            }
+            m_pool->detach(slot);
             #ifdef __cpp_exceptions
-            for (auto const& t: m_info) {
-                if (t.expception_ptr) {
-                    std::rethrow_exception(t.expception_ptr);
+            for (auto const& b: m_bodies) {
+                if (b.expception_ptr) {
+                    std::rethrow_exception(b.expception_ptr);
                 }
             }
             #endif
+            if (m_timed_out.load(std::memory_order_relaxed)) {
+                return std::unexpected(SchedulerError::deadline_exceeded);
+            }
             return {};
         }
 
+        template <typename Rep, typename Period>
+        auto run_for(std::chrono::duration<Rep, Period> timeout) -> std::expected<void, SchedulerError> {
+            return run(std::chrono::steady_clock::now() + timeout);
+        }
+
+        // INFO: Cancels the task and every task downstream of it that has not
+        // completed; their values are released and non-compiled slots are freed.
+        // It can be called while the graph is running.
+        auto cancel(DependencyTracker t) -> void {
+            assert(t.parent == this);
+            auto idx = producer_of(t.id);
+            if (idx == npos) return;
+            cancel_task(idx);
+        }
+
         template <typename T>
         auto get_result(TaskId id) -> std::expected<T, ValueStoreError> {
             if (m_is_running) return std::unexpected(ValueStoreError::not_found);
-            auto temp = m_store.consume<T>(id);
-            return temp.transform([](auto& v) { return v.take(); });
+            return m_store.take<T>(id);
         }
 
         template <typename T>
@@ -392,80 +1437,369 @@ namespace tpl {
             return get_result<T>(t.id);
         }
 
+        template <typename R>
+            requires (!std::is_void_v<R>)
+        auto get_result(TypedTracker<R> t) -> std::expected<R, ValueStoreError> {
+            return get_result<R>(t.id);
+        }
+
+        template <typename R>
+        auto get_result(PortTracker<R> t) -> std::expected<R, ValueStoreError> {
+            return get_result<R>(t.id);
+        }
+
         template <typename T>
         auto get_last_result() -> std::expected<T, ValueStoreError> {
             return get_result<T>(m_last_processed_task.load());
         }
     private:
-        auto detect_cycle(TaskId start) const -> bool {
-            std::unordered_set<std::size_t> tracker{};
-            tracker.insert(tid_to_int(start));
-            return detect_cycle(tid_to_int(start), tracker);
-        }
-
-        auto detect_cycle(std::size_t start, std::unordered_set<std::size_t>& tracker) const -> bool {
-            if (start >= m_info.size()) return false;
-            auto& info = m_info[start];
-            if (info.state != TaskState::alive) return false;
-            for (auto next_id: info.dep_signals) {
-                auto nid = tid_to_int(next_id);
-                if (tracker.contains(nid)) return true;
-                tracker.insert(nid);
-                if (detect_cycle(next_id)) return true;
+        template <typename R>
+        auto with_ports(DependencyTracker t) -> TypedTracker<R> {
+            if constexpr (internal::is_ports_v<R>) {
+                assign_ports(tid_to_int(t.id), std::tuple_size_v<R>);
+                [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+                    (m_store.reserve_inline<std::tuple_element_t<Is, R>>(port_id(t.id, Is)), ...);
+                }(std::make_index_sequence<std::tuple_size_v<R>>{});
+            } else if constexpr (!std::is_void_v<R>) {
+                // NOTE: Untyped tasks get their inline slot on their first `put`.
+                m_store.reserve_inline<R>(t.id);
             }
-            return false;
+            return { t };
+        }
+
+        // INFO: Frees are lock-free since they happen on the workers while a graph is running,
+        // but slots are only handed out by `add_task` which is never called concurrently
+        // with itself, so a single consumer keeps the stack free from ABA.
+        auto push_free_slot(std::size_t idx) noexcept -> void {
+            auto& node = m_nodes[idx];
+            auto head = m_free_slots.load(std::memory_order_relaxed);
+            do {
+                node.next_free = head;
+            } while (!m_free_slots.compare_exchange_weak(
+                head, static_cast<slot_t>(idx),
+                std::memory_order_release,
+                std::memory_order_relaxed
+            ));
         }
 
+        // INFO: Only the transition from alive to empty releases the slot so
+        // `stop` followed by `on_complete` cannot free it twice.
+        auto release_slot(std::size_t idx) noexcept -> bool {
+            if (m_nodes[idx].state.exchange(TaskState::empty) != TaskState::alive) return false;
+            m_stale_edges.store(true, std::memory_order_relaxed);
+            push_free_slot(idx);
+            return true;
+        }
+
+        auto acquire_slot() -> std::size_t {
+            auto head = m_free_slots.load(std::memory_order_acquire);
+            while (head != no_slot) {
+                auto next = m_nodes[head].next_free;
+                if (m_free_slots.compare_exchange_weak(
+                    head, next,
+                    std::memory_order_acquire,
+                    std::memory_order_acquire
+                )) {
+                    return head;
+                }
+            }
+            auto idx = m_nodes.size();
+            // NOTE: Slot `port_bit` and above would be read as a port id.
+            assert(idx < max_tasks && "too many tasks");
+            ensure_space_for(idx + 1);
+            return idx;
+        }
+
+        static constexpr auto blocks_for(std::size_t size) noexcept -> std::size_t {
+            return (size + capacity - 1) / capacity;
+        }
+
+        // INFO: Lanes other than the normal one are sized lazily by `add_task` since
+        // most graphs only use a couple of priorities.
         void ensure_space_for(std::size_t size) {
-            m_trees.resize((size + capacity - 1) / capacity);
-            m_info.resize(size);
+            for (auto l = 0ul; l < lanes; ++l) {
+                auto& trees = m_lanes[l].trees;
+                if (l != normal_lane && trees.empty()) continue;
+                trees.resize(blocks_for(size));
+            }
+            m_nodes.resize(size);
+            m_bodies.resize(size);
+            m_parked.resize(size);
+            m_estimates.resize(size);
+            m_ports.resize(size);
             m_store.resize(size);
         }
 
-        auto pop_task() -> std::optional<TaskId> {
-            for (auto& t: m_trees) {
-                auto [idx, _] = t.select();
+        // INFO: The trees are scanned in rank order since `plan` puts the most critical
+        // tasks first. Workers spread the contention inside a tree through the hint of
+        // `select`, which only reorders a few neighbouring ranks.
+        auto pop_task(std::size_t worker, std::size_t l) -> std::optional<TaskId> {
+            auto& lane = m_lanes[l];
+            if (lane.ready.load(std::memory_order_acquire) == 0) return {};
+            auto& stats = m_local[worker].stats;
+            auto sz = lane.trees.size();
+            std::size_t retries{};
+            for (auto b = 0ul; b < sz; ++b) {
+                auto [idx, _] = lane.trees[b].select(retries, worker);
                 if (idx.is_invalid()) continue;
-                return { int_to_tid(idx.index) };
+                lane.ready.fetch_sub(1);
+                if (retries) internal::WorkerCounters::add(stats.select_retries, retries);
+                return { int_to_tid(slot_at(b * capacity + idx.index)) };
             }
+            if (retries) internal::WorkerCounters::add(stats.select_retries, retries);
+            internal::WorkerCounters::add(stats.failed_pops);
             return {};
         }
 
+        template <typename Fn>
+        auto steal(std::size_t worker, Fn&& fn) -> std::invoke_result_t<Fn, LocalQueue&> {
+            auto n = m_pool->size();
+            if (n < 2) return std::nullopt;
+
+            // xorshift64
+            auto& seed = m_local[worker].seed;
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+
+            auto start = static_cast<std::size_t>(seed % n);
+            for (auto k = 0ul; k < n; ++k) {
+                auto victim = (start + k) % n;
+                if (victim == worker) continue;
+                if (auto item = fn(m_local[victim]); item) return item;
+            }
+            return std::nullopt;
+        }
+
+        auto has_work() const noexcept -> bool {
+            return m_is_running.load(std::memory_order_acquire) &&
+                m_ready.load(std::memory_order_acquire) != 0;
+        }
+
+        // INFO: Tasks are picked in the priority order: the urgent lanes, then the normal
+        // lane (local deque, signal trees and stealing) and then the rest of the lanes.
+        // Local work is preferred over the shared structures, and stealing is the last
+        // resort within a lane.
+        auto run_one(std::size_t worker) -> bool {
+            auto& local = m_local[worker];
+
+            if ((++local.ticks % aging_period) == 0) {
+                for (auto l = lanes; l > 0; --l) {
+                    if (auto id = pop_task(worker, l - 1)) {
+                        execute(*id);
+                        return true;
+                    }
+                }
+            }
+
+            for (auto l = 0ul; l < normal_lane; ++l) {
+                if (auto id = pop_task(worker, l)) {
+                    execute(*id);
+                    return true;
+                }
+            }
+            if (auto id = local.tasks.pop()) {
+                execute(*id);
+                return true;
+            }
+            if (auto id = pop_task(worker, normal_lane)) {
+                execute(*id);
+                return true;
+            }
+            if (auto id = steal(worker, [](LocalQueue& q) { return q.tasks.steal(); })) {
+                execute(*id);
+                return true;
+            }
+            for (auto l = normal_lane + 1; l < lanes; ++l) {
+                if (auto id = pop_task(worker, l)) {
+                    execute(*id);
+                    return true;
+                }
+            }
+            if (auto w = local.work.pop()) {
+                execute(*w);
+                return true;
+            }
+            if (auto w = m_queued_tasks.pop()) {
+                execute(*w);
+                return true;
+            }
+            if (auto w = steal(worker, [](LocalQueue& q) { return q.work.steal(); })) {
+                execute(*w);
+                return true;
+            }
+            return false;
+        }
+
+        auto execute(TaskId id) -> void;
+
+        auto execute(queue_item_t* w) -> void {
+            m_ready.fetch_sub(1);
+            auto start = std::chrono::steady_clock::now();
+            #ifdef TPL_ENABLE_TRACE
+            auto begin = internal::trace_now();
+            (*w)();
+            m_pool->trace({ .begin = begin, .end = internal::trace_now(), .id = 0, .kind = TraceKind::work });
+            #else
+            (*w)();
+            #endif
+            auto& stats = m_local[ThisThread::pool_id()].stats;
+            internal::WorkerCounters::add(stats.work);
+            if (!WorkerPool::s_helping) {
+                internal::WorkerCounters::add(stats.busy_ns, std::chrono::steady_clock::now() - start);
+            }
+            std::destroy_at(w);
+            m_alloc->dealloc(w);
+            if (m_pending_work.fetch_sub(1) == 1 && m_tasks.load() == 0) {
+                m_done.notify_all();
+            }
+        }
+
+        // INFO: `run` is only woken up once both counters reach zero; the seq-cst
+        // decrements make sure at least one of the two racing threads sees it.
         auto complete_one_task() -> void {
-            m_waiter.notify_all([this] {
-                m_tasks.fetch_sub(1);
-            });
+            if (m_tasks.fetch_sub(1) == 1 && m_pending_work.load() == 0) {
+                m_done.notify_all();
+            }
         }
     private:
+        // INFO: Only set if the scheduler owns its pool. Workers only touch the
+        // scheduler while it's attached during `run`, so the member order does not matter.
+        std::unique_ptr<WorkerPool> m_own_pool;
+        WorkerPool* m_pool;
         std::unique_ptr<BlockAllocator> m_alloc{ std::make_unique<BlockAllocator>() };
-        BlockSizedList<signal_tree, 1> m_trees;
-        BlockSizedList<TaskInfo, capacity> m_info;
+        // INFO: Backs `queue_work_after` and `TaskToken::schedule_after`; its thread is
+        // only started by the first timer.
+        TimerWheel m_timers{ m_alloc.get(), m_pool->config().stack_size };
+        Reactor m_reactor{ m_alloc.get(), m_pool->config().stack_size };
+        std::array<Lane, lanes> m_lanes;
+        BlockSizedList<TaskNode, capacity> m_nodes;
+        BlockSizedList<TaskBody, capacity> m_bodies;
+        BlockSizedList<ParkSlot, capacity> m_parked;
+        // INFO: Moving average of the measured run time in nanoseconds; zero if the
+        // task has never completed. Only written by the worker running the task.
+        BlockSizedList<std::uint64_t, capacity> m_estimates;
+        BlockSizedList<PortRange, capacity> m_ports;
+        // INFO: Slot that owns a port id or `no_slot` if the id is unused.
+        std::vector<slot_t> m_port_owner;
+        // INFO: Edges in the insertion order; `analyze` turns them into the rows below.
+        std::vector<edge_t> m_edges;
+        std::vector<slot_t> m_succ_row;
+        std::vector<TaskId> m_succ;
+        std::vector<slot_t> m_input_row;
+        std::vector<input_t> m_inputs;
+        // INFO: Set when a slot is released; its edges must go before the slot is reused.
+        std::atomic<bool> m_stale_edges{false};
+        // INFO: Head of the intrusive free-slot list threaded through `TaskNode::next_free`.
+        std::atomic<slot_t> m_free_slots{no_slot};
         std::atomic<std::size_t> m_tasks{0};
+        // INFO: Queued work that is either waiting or running.
+        std::atomic<std::size_t> m_pending_work{0};
+        // INFO: Tasks and work that are published but not picked yet; idle workers
+        // park while it's zero.
+        alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<std::size_t> m_ready{0};
         std::atomic<bool> m_is_running{false};
-        ValueStore m_store{m_alloc.get()};
-        WorkerPool m_pool;
-        internal::Waiter m_waiter;
-        std::atomic<TaskId> m_last_processed_task{int_to_tid(std::numeric_limits<std::size_t>::max())};
+        // INFO: Set by `run` before the workers attach; see `run(deadline)`.
+        std::chrono::steady_clock::time_point m_deadline{std::chrono::steady_clock::time_point::max()};
+        std::atomic<bool> m_timed_out{false};
+        // INFO: Set by the timer of `run(deadline)`; `TaskToken::is_cancelled` polls it
+        // instead of the clock.
+        std::atomic<bool> m_expired{false};
+        std::mutex m_deadline_mutex;
+        // INFO: Incremented by every `run`; coroutine tasks and wakers use it to tell a
+        // new run apart.
+        std::atomic<std::size_t> m_epoch{0};
+        bool m_compiled{false};
+        bool m_os_priority{false};
+        std::vector<TaskId> m_roots;
+        std::vector<TaskId> m_cycle;
+        // INFO: Topological order found by the last `analyze`.
+        std::vector<std::size_t> m_order;
+        // INFO: Slot to signal-tree position and back; see `plan`.
+        std::vector<std::size_t> m_rank;
+        std::vector<std::size_t> m_by_rank;
+        // INFO: Run times the last `plan` ranked the tasks with.
+        std::vector<std::uint64_t> m_planned_estimates;
+        // INFO: Scratch space of `plan` for the bottom levels.
+        std::vector<std::uint64_t> m_level;
+        // INFO: The value store resets its allocator between runs, so it must not
+        // share it with the task closures.
+        std::unique_ptr<BlockAllocator> m_value_alloc{ std::make_unique<BlockAllocator>() };
+        ValueStore m_store{m_value_alloc.get()};
+        internal::EventCount m_done;
+        std::atomic<TaskId> m_last_processed_task{invalid_task_id};
         Queue<queue_item_t*> m_queued_tasks;
+        // INFO: Indexed by the worker id of `m_pool`.
+        std::unique_ptr<LocalQueue[]> m_local;
     };
 
     inline auto TaskToken::schedule() noexcept -> void {
         if (m_id == invalid_task_id) return;
         auto id = tid_to_int(m_id);
-        auto& info = m_parent.m_info[id];
-        if (info.state != Scheduler::TaskState::alive) return;
+        if (m_parent.m_nodes[id].state != Scheduler::TaskState::alive) return;
         m_parent.set_signal(m_id);
         m_result = TaskResult::rescheduled;
     }
 
-    inline auto TaskToken::stop() noexcept -> void {
+    inline auto TaskToken::schedule_at(std::chrono::steady_clock::time_point tp) -> void {
         if (m_id == invalid_task_id) return;
-        m_store.remove(m_id);
         auto id = tid_to_int(m_id);
-        m_parent.m_info[id].state.store(Scheduler::TaskState::empty);
+        if (m_parent.m_nodes[id].state != Scheduler::TaskState::alive) return;
+        auto epoch = m_parent.park_slot(id, -1);
+        if (epoch != 0) m_parent.m_timers.schedule_at(tp, internal::Waker{ &m_parent, m_id, epoch });
+        m_result = TaskResult::rescheduled;
+    }
+
+    inline auto TaskToken::wait_for_io(int fd, IoEvent ev) -> std::expected<void, ReactorError> {
+        if (m_id == invalid_task_id) return std::unexpected(ReactorError::invalid_fd);
+        auto id = tid_to_int(m_id);
+        if (m_parent.m_nodes[id].state != Scheduler::TaskState::alive) return {};
+        auto epoch = m_parent.park_slot(id, fd);
+        if (epoch == 0) {
+            m_result = TaskResult::rescheduled;
+            return {};
+        }
+        auto res = m_parent.m_reactor.watch(fd, ev, internal::Waker{ &m_parent, m_id, epoch });
+        // NOTE: If the deadline claimed the task in the meantime, it resumes it anyway.
+        if (res || !m_parent.claim_parked(id, epoch)) m_result = TaskResult::rescheduled;
+        return res;
+    }
+
+    inline auto TaskToken::epoch() const noexcept -> std::size_t {
+        return m_parent.m_epoch.load(std::memory_order_relaxed);
+    }
+
+    inline auto internal::Waker::operator()() const noexcept -> void {
+        parent->on_resume(id, epoch);
+    }
+
+    inline auto TaskToken::stop() noexcept -> void {
+        if (m_id == invalid_task_id) return;
+        m_parent.drop_values(tid_to_int(m_id));
+        m_parent.retire_slot(tid_to_int(m_id));
         m_result = TaskResult::failed;
     }
 
+    inline auto TaskToken::cancel_downstream() -> void {
+        if (m_id == invalid_task_id) return;
+        stop();
+        m_parent.cancel_successors(tid_to_int(m_id));
+    }
+
+    inline auto TaskToken::is_cancelled() const noexcept -> bool {
+        if (m_id == invalid_task_id) return false;
+        return m_parent.m_nodes[tid_to_int(m_id)].state != Scheduler::TaskState::alive ||
+            m_parent.m_expired.load(std::memory_order_relaxed);
+    }
+
+    template <typename T>
+    inline auto TaskToken::put_ports(T&& ports) -> void {
+        auto base = m_parent.m_ports[tid_to_int(m_id)].base;
+        [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+            (m_store.put(port_to_tid(base + Is), std::get<Is>(std::move(ports))), ...);
+        }(std::make_index_sequence<std::tuple_size_v<std::remove_cvref_t<T>>>{});
+    }
+
     template <typename Fn>
         requires (std::is_nothrow_invocable_r_v<void, Fn>)
     inline auto TaskToken::queue_work(
@@ -475,6 +1809,25 @@ namespace tpl {
         m_parent.queue_work(std::forward<Fn>(fn), p);
     }
 
+    template <std::ranges::sized_range R>
+        requires (std::is_nothrow_invocable_r_v<void, std::ranges::range_value_t<R>&>)
+    inline auto TaskToken::queue_work_bulk(
+        R&& fns,
+        ThisThread::Priority p
+    ) -> void {
+        m_parent.queue_work_bulk(std::forward<R>(fns), p);
+    }
+
+    template <typename Fn>
+        requires (std::is_nothrow_invocable_r_v<void, std::decay_t<Fn> const&, std::size_t>)
+    inline auto TaskToken::submit_n(
+        std::size_t n,
+        Fn&& fn,
+        ThisThread::Priority p
+    ) -> void {
+        m_parent.submit_n(n, std::forward<Fn>(fn), p);
+    }
+
     template <typename Fn>
         requires (std::is_nothrow_invocable_v<Fn>)
     inline auto TaskToken::awaitable_queue_work(
@@ -484,100 +1837,170 @@ namespace tpl {
         return m_parent.awaitable_queue_work(std::forward<Fn>(fn), p);
     }
 
+    template <typename T>
+    template <typename Fn>
+        requires (internal::is_continuation_v<T, Fn>)
+    inline auto Awaiter<T>::then(
+        Fn&& fn,
+        ThisThread::Priority p
+    ) && -> Awaiter<internal::then_result_t<T, Fn>> {
+        using ret_t = internal::then_result_t<T, Fn>;
+        assert(m_owner != nullptr && "the awaiter does not belong to a scheduler");
+        auto self = std::move(*this);
+        auto res = Awaiter<ret_t>(internal::AwaiterRef<ret_t>{}, self.m_owner);
+        internal::AwaiterOps::on_ready(self, [
+            owner = self.m_owner,
+            p,
+            dst = res.m_data.share(),
+            fn = std::forward<Fn>(fn)
+        ](value_type&& val) mutable noexcept {
+            owner->queue_work([dst = std::move(dst), fn = std::move(fn), val = std::move(val)] mutable noexcept {
+                if constexpr (std::is_void_v<ret_t>) {
+                    if constexpr (std::is_void_v<T>) std::invoke(fn);
+                    else std::invoke(fn, std::move(val));
+                    dst->notify_value();
+                } else {
+                    if constexpr (std::is_void_v<T>) dst->notify_value(std::invoke(fn));
+                    else dst->notify_value(std::invoke(fn, std::move(val)));
+                }
+            }, p);
+        });
+        return res;
+    }
 
     inline auto Scheduler::DependencyTracker::deps_on(
         std::span<DependencyTracker> ids
     ) -> std::expected<void, SchedulerError> {
         for ([[maybe_unused]] auto [child, p]: ids) {
             assert(p == parent);
-            if (id == child) {
-                return std::unexpected(SchedulerError::cycle_found);
-            }
-
-            auto cid = tid_to_int(child);
+            auto res = parent->link(child, id);
+            if (!res) return res;
+        }
+        return {};
+    }
 
-            if (parent->m_info.size() <= cid) continue;
-            auto& tmp = parent->m_info[cid];
-            if (tmp.state != TaskState::alive) continue;
-            auto& ds = tmp.dep_signals;
-            if (std::find(ds.begin(), ds.end(), id) == ds.end()) {
-                ds.push_back(id);
-                if (parent->detect_cycle(child)) {
-                    ds.pop_back();
-                    return std::unexpected(SchedulerError::cycle_found);
+    inline auto Scheduler::execute(TaskId id) -> void {
+        m_ready.fetch_sub(1);
+        auto idx = tid_to_int(id);
+        auto start = std::chrono::steady_clock::now();
+        if (start >= m_deadline) {
+            m_timed_out.store(true, std::memory_order_relaxed);
+            cancel_task(idx);
+        }
+        #ifdef TPL_ENABLE_TRACE
+        auto trace_begin = internal::trace_now();
+        #endif
+        // INFO: Cancelled after it became ready; see `on_cancelled`.
+        if (m_nodes[idx].state != TaskState::alive) {
+            #ifdef TPL_ENABLE_TRACE
+            m_pool->trace({ .begin = trace_begin, .end = trace_begin, .id = static_cast<std::uint32_t>(id), .kind = TraceKind::failed });
+            #endif
+            release_inputs(idx);
+            on_failure(id);
+            return;
+        }
+        auto& info = m_bodies[idx];
+        if (m_os_priority) {
+            (void)ThisThread::set_priority(info.task.priority());
+        }
+        auto token = TaskToken(
+            *this,
+            id,
+            m_store,
+            inputs_of(idx)
+        );
+        #ifdef __cpp_exceptions
+        try {
+            info.task(token);
+        } catch (std::exception const& e) {
+            if (!info.error_handler) {
+                info.expception_ptr = std::current_exception();
+                token.m_result = TaskResult::failed;
+            } else {
+                auto should_continue = info.error_handler(e); 
+                if (!should_continue) {
+                    token.m_result = TaskResult::failed;
+                } else if (token.m_result == TaskResult::success) {
+                    token.m_result = TaskResult::failed;
                 }
-                auto& info = parent->m_info[tid_to_int(id)];
-                info.signals.fetch_add(1);
-                info.inputs.push_back({ child, false });
             }
         }
-        return {};
+        #else
+            info.task(token);
+        #endif
+        #ifdef TPL_ENABLE_TRACE
+        m_pool->trace({
+            .begin = trace_begin,
+            .end = internal::trace_now(),
+            .id = static_cast<std::uint32_t>(id),
+            .kind = token.m_result == TaskResult::success ? TraceKind::task
+                : token.m_result == TaskResult::failed ? TraceKind::failed : TraceKind::rescheduled
+        });
+        #endif
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto& stats = m_local[ThisThread::pool_id()].stats;
+        internal::WorkerCounters::add(stats.tasks);
+        if (!WorkerPool::s_helping) internal::WorkerCounters::add(stats.busy_ns, elapsed);
+        if (token.m_result == TaskResult::success) {
+            auto ns = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+            );
+            auto& estimate = m_estimates[idx];
+            estimate = estimate == 0 ? ns : estimate - estimate / 4 + ns / 4;
+        }
+        if (token.m_result != TaskResult::rescheduled) {
+            for (auto [input, _]: token.m_inputs) m_store.release_reader(input);
+        }
+        // INFO: A sink cancelled while it ran may have stored a value after `on_cancelled`.
+        if (m_nodes[idx].state != TaskState::alive && successors(idx).empty()) {
+            drop_values(idx);
+        }
+        switch (token.m_result) {
+        case TaskResult::success: on_complete(id, true); break;
+        case TaskResult::failed: on_failure(id); break;
+        case TaskResult::rescheduled: on_reschedule(id); break;
+        }
+    }
+
+    // INFO: Looks for an attached scheduler with ready work, starting from a different
+    // one every time so a busy graph cannot starve the others. If `run` is set, it
+    // runs one item of the first scheduler that has some.
+    // NOTE: It can be nested through `help_until`, so the hazard of the outer call is
+    // restored instead of cleared.
+    inline auto WorkerPool::poll(std::size_t worker, bool run) -> bool {
+        auto& self = m_workers[worker];
+        auto* outer = self.hazard.load(std::memory_order_relaxed);
+        auto n = m_used.load(std::memory_order_acquire);
+        auto found = false;
+        for (auto k = 0ul; k < n && !found; ++k) {
+            auto& slot = m_slots[(self.next + k) % n];
+            auto* s = slot.load(std::memory_order_acquire);
+            if (!s) continue;
+            self.hazard.store(s);
+            if (slot.load() != s) continue;
+            if (!s->has_work()) continue;
+            found = !run || s->run_one(worker);
+        }
+        self.hazard.store(outer, std::memory_order_release);
+        if (run) ++self.next;
+        return found;
     }
 
     inline auto WorkerPool::do_work(std::size_t thread_id) -> void {
         ThisThread::s_pool_id = thread_id;
+        s_current = this;
+        setup_thread(thread_id);
 
-        while (m_is_running.load(std::memory_order_acquire)) {
-            waiter.wait([this] {
-                return !m_is_running.load(std::memory_order_acquire) || (
-                        m_parent.m_is_running.load(std::memory_order_acquire) &&
-                        (
-                            (m_parent.m_tasks.load(std::memory_order_acquire) != 0) ||
-                            !m_parent.m_queued_tasks.empty()
-                        )
-                );
-            });
+        auto has_work = [this, thread_id] {
+            return !m_is_running.load(std::memory_order_acquire) || poll(thread_id, false);
+        };
 
-            auto idx = m_parent.pop_task();
-            if (!idx.has_value()) {
-                auto work = m_parent.m_queued_tasks.pop();
-                if (work) {
-                    auto* w = *work;
-                    auto& task = *w;
-                    auto token = TaskToken(
-                        m_parent,
-                        m_parent.m_store
-                    );
-                    task();
-                    m_parent.m_alloc->dealloc(w);
-                }
-                continue;
-            }
-            auto id = idx.value();
-            auto& info = m_parent.m_info[tid_to_int(id)];
-            auto token = TaskToken(
-                m_parent,
-                id,
-                m_parent.m_store,
-                info.inputs
-            );
-            #ifdef __cpp_exceptions
-            try {
-                info.task(token);
-            } catch (std::exception const& e) {
-                if (!info.error_handler) {
-                    info.expception_ptr = std::current_exception();
-                    token.m_result = TaskResult::failed;
-                } else {
-                    auto should_continue = info.error_handler(e); 
-                    if (!should_continue) {
-                        token.m_result = TaskResult::failed;
-                    } else if (token.m_result == TaskResult::success) {
-                        token.m_result = TaskResult::failed;
-                    }
-                }
-            }
-            #else
-                info.task(token);
-            #endif
-            if (id == invalid_task_id) return;
-            switch (token.m_result) {
-            case TaskResult::success: m_parent.on_complete(id, true); break;
-            case TaskResult::failed: m_parent.on_failure(id); break;
-            case TaskResult::rescheduled: m_parent.on_reschedule(id); break;
-            }
+        while (m_is_running.load(std::memory_order_acquire)) {
+            if (poll(thread_id, true)) continue;
+            idle(has_work);
         }
 
+        s_current = nullptr;
         ThisThread::s_pool_id = std::numeric_limits<std::size_t>::max();
     }
 
@@ -0,0 +1,115 @@
+#ifndef AMT_TPL_SCHEDULER_CONFIG_HPP
+#define AMT_TPL_SCHEDULER_CONFIG_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "thread.hpp"
+
+namespace tpl {
+
+    // INFO: How an idle worker waits for work. It spins `spin` times with a pause
+    // instruction, yields `yield` times and then parks on the eventcount. Without
+    // parking the worker never sleeps, which burns a core for the lowest wake-up
+    // latency; it only makes sense when the workers are pinned.
+    struct IdlePolicy {
+        std::size_t spin{64};
+        std::size_t yield{4};
+        bool park{true};
+
+        static constexpr auto busy_poll() noexcept -> IdlePolicy {
+            return { .spin = 64, .yield = 0, .park = false };
+        }
+    };
+
+    namespace internal {
+
+        inline auto parse_size(std::string_view s) noexcept -> std::optional<std::size_t> {
+            while (!s.empty() && s.front() == ' ') s.remove_prefix(1);
+            while (!s.empty() && s.back() == ' ') s.remove_suffix(1);
+            std::size_t res{};
+            auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), res);
+            if (ec != std::errc{} || ptr != s.data() + s.size()) return {};
+            return res;
+        }
+
+        // INFO: Parses a CPU list like "0-3,8" into a mask for `ThisThread::set_affinity`.
+        inline auto parse_cpu_list(std::string_view s) -> std::optional<std::vector<bool>> {
+            std::vector<bool> mask;
+            while (!s.empty()) {
+                auto comma = s.find(',');
+                auto item = s.substr(0, comma);
+                s = comma == std::string_view::npos ? std::string_view{} : s.substr(comma + 1);
+
+                auto dash = item.find('-');
+                auto first = parse_size(item.substr(0, dash));
+                auto last = dash == std::string_view::npos ? first : parse_size(item.substr(dash + 1));
+                if (!first || !last || *first > *last) return {};
+                if (mask.size() <= *last) mask.resize(*last + 1, false);
+                for (auto cpu = *first; cpu <= *last; ++cpu) mask[cpu] = true;
+            }
+            if (mask.empty()) return {};
+            return mask;
+        }
+
+    } // namespace internal
+
+    struct SchedulerConfig {
+        // INFO: Number of workers; zero means `hardware_max_parallism()`.
+        std::size_t nthreads{};
+        // INFO: CPU set of each worker; worker `i` is pinned to `affinity[i % affinity.size()]`.
+        // It's applied with `ThisThread::set_affinity`, and an empty list leaves the
+        // workers unpinned.
+        std::vector<std::vector<bool>> affinity{};
+        // INFO: Workers are named "<name_prefix><id>", cut to 15 characters on Linux.
+        // An empty prefix keeps the OS default.
+        std::string name_prefix{"tpl-worker-"};
+        // INFO: Stack size of the workers in bytes; zero keeps the platform default.
+        std::size_t stack_size{};
+        IdlePolicy idle{};
+        // INFO: See `Scheduler::set_os_priority`.
+        bool os_priority{false};
+        // INFO: If set, `TPL_NUM_THREADS` and `TPL_AFFINITY` override the fields above
+        // when the pool is created.
+        bool use_env{true};
+
+        constexpr auto threads() const noexcept -> std::size_t {
+            return nthreads == 0 ? hardware_max_parallism() : nthreads;
+        }
+
+        auto affinity_of(std::size_t worker) const noexcept -> std::vector<bool> const* {
+            if (affinity.empty()) return nullptr;
+            return &affinity[worker % affinity.size()];
+        }
+
+        // INFO: `TPL_NUM_THREADS=8` sets the worker count. `TPL_AFFINITY` takes CPU
+        // lists separated by ';': "0-3,8" pins every worker to the same set, while
+        // "0;1;2;3" pins the workers to one CPU each in a round-robin way. Malformed
+        // values are ignored.
+        auto apply_env() -> SchedulerConfig& {
+            if (auto const* env = std::getenv("TPL_NUM_THREADS")) {
+                if (auto n = internal::parse_size(env); n && *n != 0) nthreads = *n;
+            }
+            if (auto const* env = std::getenv("TPL_AFFINITY")) {
+                auto list = std::string_view(env);
+                std::vector<std::vector<bool>> sets;
+                while (!list.empty()) {
+                    auto semi = list.find(';');
+                    auto set = internal::parse_cpu_list(list.substr(0, semi));
+                    if (!set) return *this;
+                    sets.push_back(std::move(*set));
+                    list = semi == std::string_view::npos ? std::string_view{} : list.substr(semi + 1);
+                }
+                if (!sets.empty()) affinity = std::move(sets);
+            }
+            return *this;
+        }
+    };
+
+} // namespace tpl
+
+#endif // AMT_TPL_SCHEDULER_CONFIG_HPP
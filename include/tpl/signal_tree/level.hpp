@@ -1,6 +1,7 @@
 #ifndef AMT_TPL_SIGNAL_TREE_LEVEL_HPP
 #define AMT_TPL_SIGNAL_TREE_LEVEL_HPP
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <bit>
@@ -40,20 +41,41 @@ namespace tpl::internal {
         static constexpr auto extents = [](){
             std::array<std::size_t, levels> res{};
             for (auto i = 0ul; i < levels; ++i) {
-                auto sz = (levels - i) * (std::size_t{1} << i);
-                if (sz < NodeIntTraits::max_nodes) res[i] = sz;
-                else {
-                    res[i] = ((sz + NodeIntTraits::max_nodes - 1) / NodeIntTraits::max_nodes) * NodeIntTraits::max_nodes;
+                res[i] = (levels - i) * (std::size_t{1} << i);
+            }
+            return res;
+        }();
+
+        // INFO: A node must never straddle two words since it's updated using a single CAS.
+        // A level shares the current word only if it fits entirely; otherwise, it starts
+        // at the next word and packs as many nodes as fit into each word.
+        static constexpr auto layout = [](){
+            std::array<std::size_t, levels + 1> res{};
+            std::size_t offset{};
+            for (auto i = 0ul; i < levels; ++i) {
+                auto const bits_per_node = levels - i;
+                auto const nodes = std::size_t{1} << i;
+                auto const used = offset % NodeIntTraits::max_nodes;
+                if (used != 0 && extents[i] > NodeIntTraits::max_nodes - used) {
+                    offset += NodeIntTraits::max_nodes - used;
+                }
+                res[i] = offset;
+                if (extents[i] <= NodeIntTraits::max_nodes) {
+                    offset += extents[i];
+                } else {
+                    auto const nodes_per_word = NodeIntTraits::max_nodes / bits_per_node;
+                    offset += ((nodes + nodes_per_word - 1) / nodes_per_word) * NodeIntTraits::max_nodes;
                 }
             }
+            res[levels] = offset;
             return res;
         }();
         static constexpr auto strides = [](){
             std::array<std::size_t, extents.size()> res{};
-            std::transform(extents.begin(), extents.end() - 1, res.begin(), res.begin() + 1, std::plus<>{});
+            std::copy_n(layout.begin(), res.size(), res.begin());
             return res;
         }();
-        static constexpr std::size_t total_bits = std::accumulate(extents.begin(), extents.end(), std::size_t{}, std::plus<>{});
+        static constexpr std::size_t total_bits = layout[levels];
         static constexpr std::size_t size = (total_bits + NodeIntTraits::max_nodes - 1) / NodeIntTraits::max_nodes;
     public:
 
@@ -80,7 +102,23 @@ namespace tpl::internal {
         }
 
         TPL_ATOMIC_FUNC_ATTR auto select() noexcept -> std::pair<SignalIndex /*Index*/, bool /*IsZero*/> {
-            return select_helper<0>(SignalIndex(0));
+            std::size_t retries{};
+            return select_helper<0>(SignalIndex(0), retries, 0);
+        }
+
+        // INFO: Adds the number of failed compare-exchanges to `retries`.
+        TPL_ATOMIC_FUNC_ATTR auto select(std::size_t& retries) noexcept -> std::pair<SignalIndex /*Index*/, bool /*IsZero*/> {
+            return select_helper<0>(SignalIndex(0), retries, 0);
+        }
+
+        // INFO: Like `select`, but the low bits of `hint` pick which child is tried first
+        // on the last `hint_levels` levels. Callers with different hints take different
+        // leaves of a group of adjacent signals instead of racing for the leftmost one;
+        // the order between the groups stays leftmost first.
+        static constexpr std::size_t hint_levels = 2;
+
+        TPL_ATOMIC_FUNC_ATTR auto select(std::size_t& retries, std::size_t hint) noexcept -> std::pair<SignalIndex /*Index*/, bool /*IsZero*/> {
+            return select_helper<0>(SignalIndex(0), retries, hint);
         }
 
         constexpr auto data() const noexcept -> auto const& {
@@ -143,9 +181,12 @@ namespace tpl::internal {
         }
 
         template <std::size_t L>
-        TPL_ATOMIC_FUNC_ATTR auto select_helper(SignalIndex index) noexcept -> std::pair<SignalIndex /*Index*/, bool /*IsZero*/> {
+        TPL_ATOMIC_FUNC_ATTR auto select_helper(SignalIndex index, std::size_t& retries, std::size_t hint) noexcept -> std::pair<SignalIndex /*Index*/, bool /*IsZero*/> {
             auto left = SignalIndex(index.index * 2 + 0);
             auto right = SignalIndex(index.index * 2 + 1);
+            if constexpr (L + 1 < levels && L + 1 + hint_levels >= levels) {
+                if ((hint >> (levels - 2 - L)) & 1) std::swap(left, right);
+            }
             auto node = get_nodes<L>();
             while (true) {
                 auto data = node.get_data(index);
@@ -157,13 +198,14 @@ namespace tpl::internal {
                     if constexpr (L + 1 == levels) return { index, value == 0 };
                     break;
                 }
+                ++retries;
             }
 
             if constexpr (L < levels - 1) {
-                auto l_res = select_helper<L + 1>(left);
+                auto l_res = select_helper<L + 1>(left, retries, hint);
                 if (!l_res.first.is_invalid()) return l_res;
 
-                auto r_res = select_helper<L + 1>(right);
+                auto r_res = select_helper<L + 1>(right, retries, hint);
                 if (!r_res.first.is_invalid()) return r_res;
             }
             return { {}, true };
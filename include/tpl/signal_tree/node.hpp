@@ -114,10 +114,11 @@ namespace tpl::internal {
             std::println(">");
         }
 
+        // INFO: `Stride` is either word aligned or the whole level fits inside the word,
+        // so a node never crosses the word boundary.
         constexpr auto parse_index(SignalIndex index) const noexcept -> std::pair<std::size_t, std::size_t> {
-            auto abs_index = index.index * BitsPerNode + Stride;
-            auto block_index = abs_index / NodeIntTraits::max_nodes;
-            auto idx = abs_index % NodeIntTraits::max_nodes;
+            auto block_index = Stride / NodeIntTraits::max_nodes + index.index / nodes_per_block;
+            auto idx = Stride % NodeIntTraits::max_nodes + (index.index % nodes_per_block) * BitsPerNode;
             return { block_index, idx };
         }
     };
@@ -33,6 +33,14 @@ namespace tpl {
             return m_levels.select();
         }
 
+        TPL_ATOMIC_FUNC_ATTR auto select(std::size_t& retries) noexcept -> std::pair<SignalIndex, bool /*IsZero*/>  {
+            return m_levels.select(retries);
+        }
+
+        TPL_ATOMIC_FUNC_ATTR auto select(std::size_t& retries, std::size_t hint) noexcept -> std::pair<SignalIndex, bool /*IsZero*/>  {
+            return m_levels.select(retries, hint);
+        }
+
         TPL_ATOMIC_FUNC_ATTR auto get_empty_pos() noexcept -> std::optional<std::size_t> {
             return m_levels.get_empty_pos();
         }
@@ -0,0 +1,100 @@
+#ifndef AMT_TPL_STATS_HPP
+#define AMT_TPL_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include "atomic.hpp"
+
+namespace tpl {
+
+    // INFO: What a worker has done since the counters were last reset.
+    struct WorkerStats {
+        // INFO: Runs of task bodies, including the ones that rescheduled.
+        std::uint64_t tasks{};
+        // INFO: Queued work items that were run.
+        std::uint64_t work{};
+        // INFO: Picks from a lane that had ready tasks but lost all of them to other workers.
+        std::uint64_t failed_pops{};
+        // INFO: Failed compare-exchanges while selecting a task in the signal trees.
+        std::uint64_t select_retries{};
+        // INFO: Idle periods that ended up sleeping and the number of times the
+        // worker was woken up from them; the difference is the spurious wake-ups.
+        std::uint64_t parks{};
+        std::uint64_t wakeups{};
+        // INFO: Time spent running tasks and work; a task waiting on an awaiter stays
+        // busy while its worker helps with other work.
+        std::chrono::nanoseconds busy{};
+        // INFO: Time spent spinning, yielding and parked without work.
+        std::chrono::nanoseconds idle{};
+
+        constexpr auto operator+=(WorkerStats const& o) noexcept -> WorkerStats& {
+            tasks += o.tasks;
+            work += o.work;
+            failed_pops += o.failed_pops;
+            select_retries += o.select_retries;
+            parks += o.parks;
+            wakeups += o.wakeups;
+            busy += o.busy;
+            idle += o.idle;
+            return *this;
+        }
+    };
+
+    struct SchedulerStats {
+        WorkerStats total{};
+        // INFO: Indexed by the worker id.
+        std::vector<WorkerStats> workers{};
+    };
+
+    namespace internal {
+        // INFO: Counters of a single worker on their own cache line. Only the worker
+        // writes them, so an update is a relaxed load and store instead of a locked
+        // instruction; readers may see a slightly stale value.
+        struct alignas(atomic::internal::hardware_destructive_interference_size) WorkerCounters {
+            using counter_t = std::atomic<std::uint64_t>;
+
+            static auto add(counter_t& c, std::uint64_t n = 1) noexcept -> void {
+                c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+
+            static auto add(counter_t& c, std::chrono::steady_clock::duration d) noexcept -> void {
+                add(c, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+            }
+
+            auto snapshot() const noexcept -> WorkerStats {
+                return {
+                    .tasks = tasks.load(std::memory_order_relaxed),
+                    .work = work.load(std::memory_order_relaxed),
+                    .failed_pops = failed_pops.load(std::memory_order_relaxed),
+                    .select_retries = select_retries.load(std::memory_order_relaxed),
+                    .parks = parks.load(std::memory_order_relaxed),
+                    .wakeups = wakeups.load(std::memory_order_relaxed),
+                    .busy = std::chrono::nanoseconds(busy_ns.load(std::memory_order_relaxed)),
+                    .idle = std::chrono::nanoseconds(idle_ns.load(std::memory_order_relaxed))
+                };
+            }
+
+            // NOTE: A worker that updates a counter at the same time may undo its reset.
+            auto reset() noexcept -> void {
+                for (auto* c: { &tasks, &work, &failed_pops, &select_retries, &parks, &wakeups, &busy_ns, &idle_ns }) {
+                    c->store(0, std::memory_order_relaxed);
+                }
+            }
+
+            counter_t tasks{0};
+            counter_t work{0};
+            counter_t failed_pops{0};
+            counter_t select_retries{0};
+            counter_t parks{0};
+            counter_t wakeups{0};
+            counter_t busy_ns{0};
+            counter_t idle_ns{0};
+        };
+    } // namespace internal
+
+} // namespace tpl
+
+#endif // AMT_TPL_STATS_HPP
@@ -6,46 +6,90 @@
 #include <functional>
 #include <type_traits>
 #include <utility>
+#include "allocator.hpp"
+#include "inplace_function.hpp"
 #include "thread.hpp"
 #include "task_token.hpp"
+#include "coro.hpp"
 
 namespace tpl {
 
+    namespace internal {
+        template <typename Fn>
+        struct task_result;
+
+        template <typename Fn>
+            requires (std::invocable<std::decay_t<Fn> const&, TaskToken&>)
+        struct task_result<Fn> {
+            using type = std::remove_cvref_t<std::invoke_result_t<std::decay_t<Fn> const&, TaskToken&>>;
+        };
+
+        template <typename Fn>
+            requires (!std::invocable<std::decay_t<Fn> const&, TaskToken&> && std::invocable<std::decay_t<Fn> const&>)
+        struct task_result<Fn> {
+            using type = std::remove_cvref_t<std::invoke_result_t<std::decay_t<Fn> const&>>;
+        };
+
+        template <typename T>
+        struct unwrap_coro {
+            using type = T;
+        };
+
+        template <typename T>
+        struct unwrap_coro<Coro<T>> {
+            using type = T;
+        };
+
+        // INFO: Type of the value a task function stores in the value store; a
+        // coroutine stores the value it returns.
+        template <typename Fn>
+        using task_result_t = typename unwrap_coro<typename task_result<Fn>::type>::type;
+    } // namespace internal
+
     struct Task {
         using priority_t = ThisThread::Priority;
-        using fn_t = std::function<void(TaskToken&)>;
+        using fn_t = InplaceFunction<void(TaskToken&)>;
 
+        // INFO: Closures that do not fit in `fn_t` are spilled into `arena`, or
+        // into the heap if none is given.
         template <typename Fn>
             requires (
                 std::invocable<Fn> ||
                 std::invocable<Fn, TaskToken&>
             )
-        explicit Task(Fn&& fn, priority_t p = priority_t::normal) noexcept
+        explicit Task(Fn&& fn, priority_t p = priority_t::normal, BlockAllocator* arena = nullptr) noexcept
             : m_priority(p)
         {
-            m_fn = [fn = std::forward<Fn>(fn)](TaskToken& t) {
-                if constexpr (std::invocable<Fn, TaskToken&>) {
-                    using ret_t = decltype(std::invoke(fn, t));
-                    if constexpr (!std::is_void_v<ret_t>) {
-                        decltype(auto) res = std::invoke(fn, t);
-                        if (t.is_success()) {
-                            t.return_(std::forward<decltype(res)>(res));
+            if constexpr (internal::is_coro_v<typename internal::task_result<Fn>::type>) {
+                using value_t = internal::task_result_t<Fn>;
+                m_fn = fn_t([fn = std::forward<Fn>(fn), coro = internal::CoroTask<value_t>{}](TaskToken& t) mutable {
+                    coro(fn, t);
+                }, arena);
+            } else {
+                m_fn = fn_t([fn = std::forward<Fn>(fn)](TaskToken& t) {
+                    if constexpr (std::invocable<Fn, TaskToken&>) {
+                        using ret_t = decltype(std::invoke(fn, t));
+                        if constexpr (!std::is_void_v<ret_t>) {
+                            decltype(auto) res = std::invoke(fn, t);
+                            if (t.is_success()) {
+                                t.return_(std::forward<decltype(res)>(res));
+                            }
+                        } else {
+                            std::invoke(fn, t);
                         }
                     } else {
-                        std::invoke(fn, t);
-                    }
-                } else {
-                    using ret_t = decltype(std::invoke(fn));
-                    if constexpr (!std::is_void_v<ret_t>) {
-                        decltype(auto) res = std::invoke(fn);
-                        if (t.is_success()) {
-                            t.return_(std::forward<decltype(res)>(res));
+                        using ret_t = decltype(std::invoke(fn));
+                        if constexpr (!std::is_void_v<ret_t>) {
+                            decltype(auto) res = std::invoke(fn);
+                            if (t.is_success()) {
+                                t.return_(std::forward<decltype(res)>(res));
+                            }
+                        } else {
+                            std::invoke(fn);
                         }
-                    } else {
-                        std::invoke(fn);
                     }
-                }
-            };
+                }, arena);
+            }
         }
 
         Task() noexcept = default;
@@ -56,8 +100,6 @@ namespace tpl {
         ~Task() noexcept = default;
 
         auto operator()(TaskToken& token) const {
-            [[maybe_unused]] auto is_priority_set = ThisThread::set_priority(m_priority);
-            assert(is_priority_set == true);
             m_fn(token);
         }
 
@@ -71,10 +113,12 @@ namespace tpl {
 
 
     struct ErrorHandler {
+        using fn_t = InplaceFunction<bool(std::exception const&)>;
+
         ErrorHandler() noexcept = default;
-        ErrorHandler(ErrorHandler const&) noexcept = default;
+        ErrorHandler(ErrorHandler const&) noexcept = delete;
         ErrorHandler(ErrorHandler &&) noexcept = default;
-        ErrorHandler& operator=(ErrorHandler const&) noexcept = default;
+        ErrorHandler& operator=(ErrorHandler const&) noexcept = delete;
         ErrorHandler& operator=(ErrorHandler &&) noexcept = default;
         ~ErrorHandler() noexcept = default;
 
@@ -89,8 +133,8 @@ namespace tpl {
                 std::invocable<Fn> || 
                 std::invocable<Fn>
             )
-        explicit ErrorHandler(Fn&& fn) {
-            m_handler = [fn = std::forward<Fn>(fn)](std::exception const& e) noexcept -> bool {
+        explicit ErrorHandler(Fn&& fn, BlockAllocator* arena = nullptr) {
+            m_handler = fn_t([fn = std::forward<Fn>(fn)](std::exception const& e) noexcept -> bool {
                 if constexpr (std::invocable<Fn, std::exception const&>) {
                     using ret_t = decltype(std::invoke(fn, e));
                     if constexpr (std::is_void_v<ret_t>) {
@@ -108,15 +152,15 @@ namespace tpl {
                         return std::invoke(fn);
                     }
                 }
-            };
+            }, arena);
         }
 
         auto operator()(std::exception const& e) const noexcept -> bool {
             if (!m_handler) return false;
-            return m_handler(std::move(e));
+            return m_handler(e);
         }
     private:
-        std::function<bool(std::exception const&)> m_handler{nullptr};
+        fn_t m_handler;
     };
 } // namespace tpl
 
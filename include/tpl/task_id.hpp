@@ -1,13 +1,17 @@
 #ifndef AMT_TPL_TASK_ID_HPP
 #define AMT_TPL_TASK_ID_HPP
 
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 
 namespace tpl {
-    enum class TaskId: std::size_t {};
+    // INFO: 32 bits halve the size of the edges. The top bit marks a port (see
+    // `port_bit`), which leaves room for `max_tasks`, i.e. 2^31 - 1 tasks.
+    enum class TaskId: std::uint32_t {};
     static constexpr auto invalid_task_id = static_cast<TaskId>(
-        std::numeric_limits<std::size_t>::max()
+        std::numeric_limits<std::uint32_t>::max()
     );
 
     constexpr auto tid_to_int(TaskId id) noexcept -> std::size_t {
@@ -15,7 +19,25 @@ namespace tpl {
     }
 
     constexpr auto int_to_tid(std::size_t id) noexcept -> TaskId {
-        return static_cast<TaskId>(id);
+        assert(id <= std::numeric_limits<std::uint32_t>::max() && "task id does not fit in 32 bits");
+        return static_cast<TaskId>(static_cast<std::uint32_t>(id));
+    }
+
+    // INFO: Output ports of a task are addressed by ids with the top bit set, so a
+    // port can be used wherever the value of a task is looked up by its id.
+    static constexpr std::uint32_t port_bit = std::uint32_t{1} << 31;
+    static constexpr std::size_t max_tasks = port_bit - 1;
+
+    constexpr auto is_port_id(TaskId id) noexcept -> bool {
+        return id != invalid_task_id && (static_cast<std::uint32_t>(id) & port_bit) != 0;
+    }
+
+    constexpr auto port_to_tid(std::size_t port) noexcept -> TaskId {
+        return static_cast<TaskId>(static_cast<std::uint32_t>(port) | port_bit);
+    }
+
+    constexpr auto tid_to_port(TaskId id) noexcept -> std::size_t {
+        return static_cast<std::size_t>(static_cast<std::uint32_t>(id) & ~port_bit);
     }
 } // namespace tpl
 
@@ -2,15 +2,24 @@
 #define AMT_TPL_TASK_TOKEN_HPP
 
 #include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iterator>
 #include <limits>
+#include <ranges>
+#include <span>
 #include <tuple>
 #include <utility>
 #include "awaiter.hpp"
 #include "thread.hpp"
 #include "worker_pool.hpp"
 #include "value_store.hpp"
+#include "ports.hpp"
+#include "reactor.hpp"
 #include "task_id.hpp"
 #include "cow.hpp"
 
@@ -45,7 +54,92 @@ namespace tpl {
         rescheduled
     };
 
+    struct TaskToken;
+
+    namespace internal {
+        template <typename T>
+        struct CoroTask;
+
+        // INFO: Signals a parked task again; see `TaskToken::park`.
+        struct Waker {
+            Scheduler* parent;
+            TaskId id;
+            // INFO: Run that parked the task on the timer wheel or the reactor; zero
+            // for `TaskToken::park`. A stale waker is ignored; see `Scheduler::on_resume`.
+            std::size_t epoch{};
+
+            auto operator()() const noexcept -> void;
+        };
+
+        // INFO: Matches `Scheduler::TypedTracker<T>` for a non-void `T`.
+        template <typename T>
+        concept typed_tracker = requires (T t) {
+            typename T::result_type;
+            { t.id } -> std::convertible_to<TaskId>;
+        } && !std::is_void_v<typename T::result_type>;
+
+        // INFO: Lazily resolved view over the inputs of a task holding a `T`;
+        // inputs that failed, produced another type or were already consumed are
+        // skipped. Consumable inputs are moved out of the store when dereferenced,
+        // so an iterator must be dereferenced at most once.
+        template <typename T>
+        struct InputRange {
+            struct iterator {
+                using iterator_category = std::input_iterator_tag;
+                using value_type = Cow<T>;
+                using difference_type = std::ptrdiff_t;
+
+                constexpr iterator() noexcept = default;
+                constexpr iterator(TaskToken* token, std::size_t pos) noexcept
+                    : m_token(token)
+                    , m_pos(pos)
+                {
+                    skip();
+                }
+
+                auto operator*() const -> Cow<T>;
+
+                auto operator++() noexcept -> iterator& {
+                    ++m_pos;
+                    skip();
+                    return *this;
+                }
+
+                auto operator++(int) noexcept -> void {
+                    ++*this;
+                }
+
+                constexpr auto operator==(iterator const& other) const noexcept -> bool {
+                    return m_pos == other.m_pos;
+                }
+
+            private:
+                auto skip() noexcept -> void;
+            private:
+                TaskToken* m_token{nullptr};
+                std::size_t m_pos{};
+            };
+
+            auto begin() const noexcept -> iterator;
+            auto end() const noexcept -> iterator;
+
+            // INFO: Number of inputs holding a `T`; it scans the inputs.
+            auto size() const noexcept -> std::size_t {
+                auto n = std::size_t{};
+                for (auto it = begin(); it != end(); ++it) ++n;
+                return n;
+            }
+
+            auto empty() const noexcept -> bool {
+                return begin() == end();
+            }
+
+            TaskToken* token;
+        };
+    } // namespace internal
+
     struct TaskToken {
+        using input_t = std::pair<TaskId, bool /*consumable*/>;
         static constexpr auto invalid = std::numeric_limits<std::size_t>::max();
         constexpr TaskToken(TaskToken const&) noexcept = delete;
         constexpr TaskToken(TaskToken &&) noexcept = delete;
@@ -57,11 +151,11 @@ namespace tpl {
             Scheduler& parent,
             TaskId tid,
             ValueStore& store,
-            std::vector<std::pair<TaskId, bool /*consumable*/>> inputs
+            std::span<input_t const> inputs
         )
             : m_id(tid)
             , m_store(store)
-            , m_inputs(std::move(inputs))
+            , m_inputs(inputs)
             , m_parent(parent)
         {}
 
@@ -82,21 +176,56 @@ namespace tpl {
         auto return_(T&& val) -> bool {
             if (m_id == invalid_task_id) return false;
             if (m_result == TaskResult::failed) return false;
-            m_store.put(m_id, std::forward<T>(val));
+            if constexpr (internal::is_ports_v<T>) {
+                put_ports(std::forward<T>(val));
+            } else {
+                m_store.put(m_id, std::forward<T>(val));
+            }
             return true;
         }
 
+        // INFO: Inputs are ordered by the order in which the edges were added.
+        constexpr auto inputs() const noexcept -> std::span<input_t const> {
+            return m_inputs;
+        }
+
         template <typename T>
         [[nodiscard]] auto arg(TaskId id) -> std::expected<Cow<T>, TaskError> {
-            auto it = std::find_if(m_inputs.begin(), m_inputs.end(), [id](auto el) {
-                return el.first == id;
-            });
+            return arg_at<T>(index_of(id));
+        }
 
-            if (it == m_inputs.end()) {
+        // INFO: Typed argument; the type comes from the tracker so the store skips
+        // its type check. Inline results are copied straight out of the producer's
+        // slot. The tracker must be an input of this task; reading the inputs in
+        // the order of the edges finds each of them without a search.
+        template <internal::typed_tracker Tracker>
+        [[nodiscard]] auto arg(Tracker t) -> std::expected<Cow<typename Tracker::result_type>, TaskError> {
+            using value_t = typename Tracker::result_type;
+            auto index = index_of(t.id);
+            if (index >= m_inputs.size()) {
                 return std::unexpected(TaskError::invalid_task_id);
             }
+            if constexpr (internal::is_inline_value_v<value_t>) {
+                // NOTE: A copy leaves the slot to the reader count like a shared value.
+                auto ptr = m_store.get_inline<value_t>(t.id);
+                if (!ptr) return std::unexpected(TaskError::not_found);
+                return Cow<value_t>(*ptr);
+            } else {
+                auto [id, consumable] = m_inputs[index];
+                auto res = consumable ? m_store.consume_unchecked<value_t>(id) : m_store.get_unchecked<value_t>(id);
+                if (res) return std::move(res.value());
+                return std::unexpected(to_task_error(res.error()));
+            }
+        }
 
-            auto consumable = it->second;
+        // INFO: Value of the `index`-th input; unlike `arg(TaskId)` it does not search.
+        template <typename T>
+        [[nodiscard]] auto arg_at(std::size_t index) -> std::expected<Cow<T>, TaskError> {
+            if (index >= m_inputs.size()) {
+                return std::unexpected(TaskError::invalid_task_id);
+            }
+
+            auto [id, consumable] = m_inputs[index];
 
             if (consumable) {
                 auto tmp = m_store.consume<T>(id).transform_error([](ValueStoreError e) {
@@ -110,16 +239,33 @@ namespace tpl {
             }
         }
 
+        // INFO: Read-only access to an input that never copies or moves it. A value
+        // shared by several consumers is freed once the last of them finishes, so the
+        // view must not outlive the task.
+        template <typename T>
+        [[nodiscard]] auto view(TaskId id) const -> std::expected<std::reference_wrapper<T const>, TaskError> {
+            return view_at<T>(index_of(id));
+        }
+
+        template <internal::typed_tracker Tracker>
+        [[nodiscard]] auto view(Tracker t) const -> std::expected<std::reference_wrapper<typename Tracker::result_type const>, TaskError> {
+            return view<typename Tracker::result_type>(t.id);
+        }
+
         template <typename T>
-        [[nodiscard]] auto all_of() -> std::vector<Cow<T>> {
-            std::vector<Cow<T>> res;
-            res.reserve(m_inputs.size());
-            for (auto [id, _]: m_inputs) {
-                auto tmp = arg<T>(id);
-                if (!tmp) continue;
-                res.emplace_back(std::move(*tmp));
+        [[nodiscard]] auto view_at(std::size_t index) const -> std::expected<std::reference_wrapper<T const>, TaskError> {
+            if (index >= m_inputs.size()) {
+                return std::unexpected(TaskError::invalid_task_id);
             }
-            return res;
+            return m_store.view<T>(m_inputs[index].first).transform_error([](ValueStoreError e) {
+                return to_task_error(e);
+            });
+        }
+
+        // INFO: Iterates the inputs holding a `T` without allocating.
+        template <typename T>
+        [[nodiscard]] auto all_of() noexcept -> internal::InputRange<T> {
+            return { this };
         }
 
         template <typename... Ts>
@@ -129,11 +275,11 @@ namespace tpl {
             std::array<std::size_t, sizeof...(Ts)> ids;
             std::fill(ids.begin(), ids.end(), invalid);
 
-            for (auto id: m_inputs) {
-                auto tid = m_store.get_type(id.first);
+            for (auto k = 0ul; k < m_inputs.size(); ++k) {
+                auto tid = m_store.get_type(m_inputs[k].first);
                 for (auto i = 0ul; i < type_ids.size(); ++i) {
                     if (tid == type_ids[i] && ids[i] == invalid) {
-                        ids[i] = tid_to_int(id.first);
+                        ids[i] = k;
                         break;
                     }
                 }
@@ -142,18 +288,49 @@ namespace tpl {
             auto helper = [this, &ids]<std::size_t... Is>(std::index_sequence<Is...>)
                 -> std::tuple<std::expected<Cow<Ts>, TaskError>...>
             {
-                return std::make_tuple(std::move(this->arg<Ts>(int_to_tid(ids[Is])))...);
+                return std::make_tuple(std::move(this->arg_at<Ts>(ids[Is]))...);
             };
             return helper(std::make_index_sequence<sizeof...(Ts)>{});
         }
 
         auto schedule() noexcept -> void;
+        // INFO: Like `schedule`, but the task only becomes ready once the time has
+        // come; the worker is free in the meantime.
+        auto schedule_at(std::chrono::steady_clock::time_point tp) -> void;
+        template <typename Rep, typename Period>
+        auto schedule_after(std::chrono::duration<Rep, Period> delay) -> void {
+            schedule_at(std::chrono::steady_clock::now() + delay);
+        }
+        // INFO: Parks the task until the descriptor is ready and signals it again. The
+        // descriptor should be non-blocking, so the task can try the call first and
+        // only wait on `EAGAIN`; see `Reactor` for the rules.
+        auto wait_readable(int fd) -> std::expected<void, ReactorError> {
+            return wait_for_io(fd, IoEvent::readable);
+        }
+        auto wait_writable(int fd) -> std::expected<void, ReactorError> {
+            return wait_for_io(fd, IoEvent::writable);
+        }
         auto stop() noexcept -> void;
+        // INFO: Stops this task and cancels every task downstream of it; see `Scheduler::cancel`.
+        auto cancel_downstream() -> void;
+        // INFO: Long running tasks can poll it to give up early.
+        auto is_cancelled() const noexcept -> bool;
 
         constexpr auto is_success() const noexcept -> bool {
             return m_result == TaskResult::success;
         }
 
+        constexpr auto is_rescheduled() const noexcept -> bool {
+            return m_result == TaskResult::rescheduled;
+        }
+
+        // INFO: Parks the task until the returned waker is called, which has to
+        // happen exactly once; it's how event sources resume a task.
+        auto park() noexcept -> internal::Waker {
+            m_result = TaskResult::rescheduled;
+            return { &m_parent, m_id };
+        }
+
         template <typename Fn>
             requires (std::is_nothrow_invocable_v<Fn>)
         auto awaitable_queue_work(
@@ -167,15 +344,90 @@ namespace tpl {
             Fn&& fn,
             ThisThread::Priority p = ThisThread::Priority::normal
         ) -> void;
+
+        template <std::ranges::sized_range R>
+            requires (std::is_nothrow_invocable_r_v<void, std::ranges::range_value_t<R>&>)
+        auto queue_work_bulk(
+            R&& fns,
+            ThisThread::Priority p = ThisThread::Priority::normal
+        ) -> void;
+
+        template <typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, std::decay_t<Fn> const&, std::size_t>)
+        auto submit_n(
+            std::size_t n,
+            Fn&& fn,
+            ThisThread::Priority p = ThisThread::Priority::normal
+        ) -> void;
+    private:
+        // INFO: Position of `id` in the inputs or `m_inputs.size()` if it's not one.
+        // The input after the last one found is tried first, so reading the inputs
+        // in order doesn't search.
+        auto index_of(TaskId id) const noexcept -> std::size_t {
+            if (m_next_input < m_inputs.size() && m_inputs[m_next_input].first == id) {
+                return m_next_input++;
+            }
+            auto it = std::find_if(m_inputs.begin(), m_inputs.end(), [id](auto el) {
+                return el.first == id;
+            });
+            auto index = static_cast<std::size_t>(it - m_inputs.begin());
+            if (index < m_inputs.size()) m_next_input = index + 1;
+            return index;
+        }
+
+        // INFO: Stores every element of a `Ports` result under its own port id.
+        template <typename T>
+        auto put_ports(T&& ports) -> void;
+        auto wait_for_io(int fd, IoEvent ev) -> std::expected<void, ReactorError>;
+        // INFO: Number of the current `Scheduler::run`.
+        auto epoch() const noexcept -> std::size_t;
     private:
         friend struct WorkerPool;
+        friend struct Scheduler;
+        template <typename T>
+        friend struct internal::InputRange;
+        template <typename T>
+        friend struct internal::CoroTask;
     private:
         TaskId m_id{};
         ValueStore& m_store;
-        std::vector<std::pair<TaskId, bool /*consumable*/>> m_inputs;
+        // INFO: View into the scheduler's input rows; they are only rebuilt by `Scheduler::run`.
+        std::span<input_t const> m_inputs;
+        // INFO: Hint of `index_of`.
+        mutable std::size_t m_next_input{};
         TaskResult m_result{ TaskResult::success };
         Scheduler& m_parent;
     };
+    namespace internal {
+        template <typename T>
+        inline auto InputRange<T>::iterator::operator*() const -> Cow<T> {
+            auto res = m_token->template arg_at<T>(m_pos);
+            // NOTE: `skip` only stops at ready values; it fails if the input was
+            // consumed after the iterator got here, e.g. by a second dereference.
+            assert(res.has_value() && "the input was consumed after the iterator reached it");
+            return std::move(*res);
+        }
+
+        template <typename T>
+        inline auto InputRange<T>::iterator::skip() noexcept -> void {
+            // INFO: `get_type` is null unless the value is ready, so consumed inputs are skipped.
+            auto inputs = m_token->m_inputs;
+            auto type = ValueStoreDestructor<T>::destroy;
+            while (m_pos < inputs.size() && m_token->m_store.get_type(inputs[m_pos].first) != type) {
+                ++m_pos;
+            }
+        }
+
+        template <typename T>
+        inline auto InputRange<T>::begin() const noexcept -> iterator {
+            return { token, 0 };
+        }
+
+        template <typename T>
+        inline auto InputRange<T>::end() const noexcept -> iterator {
+            return { token, token->m_inputs.size() };
+        }
+    } // namespace internal
 } // namespace tpl
 
 #endif // AMT_TPL_TASK_TOKEN_HPP
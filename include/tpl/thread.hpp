@@ -2,12 +2,20 @@
 #define AMT_TPL_THREAD_HPP
 
 #include "hw_config.hpp"
+#include <algorithm>
+#include <climits>
 #include <cstdint>
+#include <cstdlib>
 #include <vector>
 #include <cstring>
+#include <functional>
 #include <limits>
+#include <memory>
 #include <optional>
+#include <string>
+#include <system_error>
 #include <thread>
+#include <utility>
 #include <chrono>
 
 #if __has_include(<unistd.h>)
@@ -22,6 +30,10 @@
 #error "Unknown platform"
 #endif
 
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
 #ifdef __linux__
     #include <sys/syscall.h>
     #include <sys/sysinfo.h>
@@ -601,6 +613,18 @@ namespace tpl {
             return std::this_thread::yield();
         }
 
+        // INFO: Tells the CPU that the thread is spinning so the sibling hyper-thread
+        // can make progress.
+        static auto pause() noexcept -> void {
+        #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+            _mm_pause();
+        #elif defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+        #elif defined(__aarch64__) || defined(__arm__)
+            asm volatile("yield" ::: "memory");
+        #endif
+        }
+
         static auto sleep_for(const std::chrono::nanoseconds& ns) noexcept -> void {
             return std::this_thread::sleep_for(ns);
         }
@@ -659,6 +683,105 @@ namespace tpl {
     inline thread_local ThisThread::Priority ThisThread::s_priority = ThisThread::get_priority().value_or(Priority::normal);
     inline thread_local std::size_t ThisThread::s_pool_id = std::numeric_limits<std::size_t>::max();
 
+    // INFO: Joinable thread that can be started with a custom stack size, which
+    // `std::thread` does not support. A stack size of zero keeps the platform default.
+    struct Thread {
+        Thread() noexcept = default;
+
+        template <typename Fn>
+            requires std::invocable<Fn>
+        Thread(std::size_t stack_size, Fn&& fn) {
+            auto state = std::make_unique<std::function<void()>>(std::forward<Fn>(fn));
+        #if defined(_WIN32)
+            m_handle = CreateThread(
+                nullptr,
+                stack_size,
+                &Thread::entry,
+                state.get(),
+                stack_size == 0 ? 0 : STACK_SIZE_PARAM_IS_A_RESERVATION,
+                nullptr
+            );
+            if (m_handle == nullptr) fail(static_cast<int>(GetLastError()));
+        #else
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            if (stack_size != 0) {
+                auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+                auto size = std::max<std::size_t>(stack_size, PTHREAD_STACK_MIN);
+                size = (size + page - 1) / page * page;
+                pthread_attr_setstacksize(&attr, size);
+            }
+            auto res = pthread_create(&m_handle, &attr, &Thread::entry, state.get());
+            pthread_attr_destroy(&attr);
+            if (res != 0) fail(res);
+        #endif
+            m_joinable = true;
+            (void)state.release();
+        }
+        Thread(Thread const&) = delete;
+        Thread(Thread && other) noexcept
+            : m_handle(std::exchange(other.m_handle, {}))
+            , m_joinable(std::exchange(other.m_joinable, false))
+        {}
+        Thread& operator=(Thread const&) = delete;
+        Thread& operator=(Thread && other) noexcept {
+            if (this == &other) return *this;
+            if (joinable()) join();
+            m_handle = std::exchange(other.m_handle, {});
+            m_joinable = std::exchange(other.m_joinable, false);
+            return *this;
+        }
+        ~Thread() {
+            if (joinable()) join();
+        }
+
+        constexpr auto joinable() const noexcept -> bool {
+            return m_joinable;
+        }
+
+        auto join() -> void {
+            if (!m_joinable) return;
+        #if defined(_WIN32)
+            WaitForSingleObject(m_handle, INFINITE);
+            CloseHandle(m_handle);
+        #else
+            pthread_join(m_handle, nullptr);
+        #endif
+            m_joinable = false;
+        }
+
+    private:
+        [[noreturn]] static auto fail([[maybe_unused]] int code) -> void {
+        #ifdef __cpp_exceptions
+            throw std::system_error(code, std::system_category(), "failed to create a thread");
+        #else
+            std::abort();
+        #endif
+        }
+
+    #if defined(_WIN32)
+        static DWORD WINAPI entry(LPVOID arg) {
+            auto fn = std::unique_ptr<std::function<void()>>(static_cast<std::function<void()>*>(arg));
+            (*fn)();
+            return 0;
+        }
+    #else
+        static auto entry(void* arg) -> void* {
+            auto fn = std::unique_ptr<std::function<void()>>(static_cast<std::function<void()>*>(arg));
+            (*fn)();
+            return nullptr;
+        }
+    #endif
+
+    private:
+    #if defined(_WIN32)
+        HANDLE m_handle{nullptr};
+    #else
+        pthread_t m_handle{};
+    #endif
+        bool m_joinable{false};
+    };
+
     inline static std::size_t hardware_max_parallism() noexcept {
         return std::max(hardware_cpu_info.active_cpus, hardware_cpu_info.active_cpus / hardware_cpu_info.logical_cpus / hardware_cpu_info.physical_cpus);
     }
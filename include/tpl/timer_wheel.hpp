@@ -0,0 +1,299 @@
+#ifndef AMT_TPL_TIMER_WHEEL_HPP
+#define AMT_TPL_TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "allocator.hpp"
+#include "inplace_function.hpp"
+#include "thread.hpp"
+#include "waiter.hpp"
+
+namespace tpl {
+
+    // INFO: Hierarchical timer wheel with microsecond ticks. Every level has 64 slots
+    // and covers 64 times the range of the level below, so six levels reach about
+    // 19 hours; timers further away wait on an overflow list that is re-inserted
+    // whenever the top level wraps around. Inserting and firing a timer is O(1). Any
+    // thread can add timers through a lock-free inbox; the wheel itself is only touched
+    // by its timer thread, which is started on the first timer and sleeps until the
+    // next one is due. The callbacks run on the timer thread, so they should only hand
+    // the work over.
+    struct TimerWheel {
+        using clock = std::chrono::steady_clock;
+        using callback_t = InplaceFunction<void()>;
+        using tick_t = std::uint64_t;
+
+        static constexpr std::size_t slot_bits = 6;
+        static constexpr std::size_t slots = std::size_t{1} << slot_bits;
+        static constexpr std::size_t levels = 6;
+        // INFO: Ticks covered by the whole wheel minus one; also the mask of a window.
+        static constexpr tick_t max_delay = (tick_t{1} << (slot_bits * levels)) - 1;
+        // INFO: A condition variable wakes up tens of microseconds late, so the timer
+        // thread yields instead of sleeping for the last stretch.
+        static constexpr auto spin_window = std::chrono::microseconds(200);
+
+        explicit TimerWheel(BlockAllocator* arena = nullptr, std::size_t stack_size = 0) noexcept
+            : m_arena(arena)
+            , m_stack_size(stack_size)
+        {}
+        TimerWheel(TimerWheel const&) = delete;
+        TimerWheel(TimerWheel &&) = delete;
+        TimerWheel& operator=(TimerWheel const&) = delete;
+        TimerWheel& operator=(TimerWheel &&) = delete;
+        // INFO: Timers that have not fired are dropped without running them.
+        ~TimerWheel() {
+            stop();
+            destroy_list(m_inbox.exchange(nullptr));
+            destroy_list(std::exchange(m_ready, nullptr));
+            destroy_list(std::exchange(m_overflow, nullptr));
+            for (auto& level: m_slots) {
+                for (auto& head: level) destroy_list(std::exchange(head, nullptr));
+            }
+        }
+
+        template <typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, Fn>)
+        auto schedule_at(clock::time_point tp, Fn&& fn) -> void {
+            auto expiry = to_tick(tp);
+            auto e = make_entry(expiry, std::forward<Fn>(fn));
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+            auto head = m_inbox.load(std::memory_order_relaxed);
+            do {
+                e->next = head;
+            } while (!m_inbox.compare_exchange_weak(head, e));
+            start();
+            // INFO: Pairs with the store in `sleep`; one of the two sides sees the other.
+            // The entry may already be gone, so it's not touched after the push.
+            if (expiry < m_sleep_until.load()) m_waiter.notify_one();
+        }
+
+        template <typename Rep, typename Period, typename Fn>
+            requires (std::is_nothrow_invocable_r_v<void, Fn>)
+        auto schedule_after(std::chrono::duration<Rep, Period> delay, Fn&& fn) -> void {
+            schedule_at(clock::now() + delay, std::forward<Fn>(fn));
+        }
+
+        // INFO: Timers that have been added but have not fired yet.
+        auto pending() const noexcept -> std::size_t {
+            return m_pending.load(std::memory_order_acquire);
+        }
+
+        auto stop() -> void {
+            std::lock_guard lock(m_mutex);
+            if (!m_thread.joinable()) return;
+            m_waiter.notify_all([this] {
+                m_running.store(false, std::memory_order_release);
+            });
+            m_thread.join();
+        }
+    private:
+        struct Entry {
+            tick_t expiry;
+            Entry* next{nullptr};
+            callback_t fn;
+        };
+
+        auto start() -> void {
+            if (m_started.load(std::memory_order_acquire)) return;
+            std::lock_guard lock(m_mutex);
+            if (m_started.load(std::memory_order_relaxed)) return;
+            m_running.store(true, std::memory_order_relaxed);
+            m_thread = Thread(m_stack_size, [this] { loop(); });
+            m_started.store(true, std::memory_order_release);
+        }
+
+        auto to_tick(clock::time_point tp) const noexcept -> tick_t {
+            if (tp <= m_epoch) return 0;
+            // NOTE: Rounded up so a timer never fires early.
+            auto us = std::chrono::ceil<std::chrono::microseconds>(tp - m_epoch).count();
+            return static_cast<tick_t>(us);
+        }
+
+        // NOTE: Rounded down, unlike the expiry, so the tick has fully passed.
+        auto now_tick() const noexcept -> tick_t {
+            auto us = std::chrono::floor<std::chrono::microseconds>(clock::now() - m_epoch).count();
+            return us < 0 ? 0 : static_cast<tick_t>(us);
+        }
+
+        template <typename Fn>
+        auto make_entry(tick_t expiry, Fn&& fn) -> Entry* {
+            Entry* e = m_arena ? m_arena->alloc<Entry>() : static_cast<Entry*>(::operator new(sizeof(Entry)));
+            return new(e) Entry{ .expiry = expiry, .next = nullptr, .fn = callback_t(std::forward<Fn>(fn), m_arena) };
+        }
+
+        auto free_entry(Entry* e) noexcept -> void {
+            std::destroy_at(e);
+            if (m_arena) m_arena->dealloc(e);
+            else ::operator delete(e);
+        }
+
+        auto destroy_list(Entry* e) noexcept -> void {
+            while (e) {
+                auto next = e->next;
+                free_entry(e);
+                e = next;
+            }
+        }
+
+        auto loop() -> void {
+            while (m_running.load(std::memory_order_acquire)) {
+                drain();
+                advance(now_tick());
+                fire();
+                sleep();
+            }
+        }
+
+        auto drain() noexcept -> void {
+            auto e = m_inbox.exchange(nullptr, std::memory_order_acquire);
+            while (e) {
+                auto next = e->next;
+                insert(e);
+                e = next;
+            }
+        }
+
+        // INFO: The level is picked by the highest 6-bit group in which the expiry
+        // differs from the current tick, so a slot always lies in the future of its level.
+        auto insert(Entry* e) noexcept -> void {
+            if (e->expiry <= m_current) {
+                e->next = m_ready;
+                m_ready = e;
+                return;
+            }
+            auto level = static_cast<std::size_t>(std::bit_width(e->expiry ^ m_current) - 1) / slot_bits;
+            if (level >= levels) {
+                e->next = m_overflow;
+                m_overflow = e;
+                return;
+            }
+            auto slot = (e->expiry >> (level * slot_bits)) & (slots - 1);
+            e->next = m_slots[level][slot];
+            m_slots[level][slot] = e;
+            m_bitmap[level] |= std::uint64_t{1} << slot;
+        }
+
+        // INFO: The next tick at which a slot is either due (level zero) or has to be
+        // cascaded into the lower levels; it jumps over empty slots using the bitmaps.
+        auto next_event() const noexcept -> tick_t {
+            auto best = std::numeric_limits<tick_t>::max();
+            for (auto l = 0ul; l < levels; ++l) {
+                auto shift = l * slot_bits;
+                auto cur = (m_current >> shift) & (slots - 1);
+                auto from = l == 0 ? cur : cur + 1;
+                if (from >= slots) continue;
+                auto occupied = m_bitmap[l] & (~std::uint64_t{0} << from);
+                if (occupied == 0) continue;
+                auto s = static_cast<tick_t>(std::countr_zero(occupied));
+                auto base = m_current & ~((tick_t{1} << (shift + slot_bits)) - 1);
+                best = std::min(best, base | (s << shift));
+            }
+            if (m_overflow) best = std::min(best, (m_current | max_delay) + 1);
+            return best;
+        }
+
+        auto take_slot(std::size_t level, std::size_t slot) noexcept -> Entry* {
+            m_bitmap[level] &= ~(std::uint64_t{1} << slot);
+            return std::exchange(m_slots[level][slot], nullptr);
+        }
+
+        auto advance(tick_t now) noexcept -> void {
+            while (true) {
+                auto next = next_event();
+                if (next > now) break;
+                m_current = next;
+                if ((m_current & max_delay) == 0) {
+                    auto e = std::exchange(m_overflow, nullptr);
+                    while (e) {
+                        auto n = e->next;
+                        insert(e);
+                        e = n;
+                    }
+                }
+                for (auto l = levels - 1; l > 0; --l) {
+                    auto shift = l * slot_bits;
+                    if ((m_current & ((tick_t{1} << shift) - 1)) != 0) continue;
+                    auto e = take_slot(l, (m_current >> shift) & (slots - 1));
+                    while (e) {
+                        auto n = e->next;
+                        insert(e);
+                        e = n;
+                    }
+                }
+                auto e = take_slot(0, m_current & (slots - 1));
+                while (e) {
+                    auto n = e->next;
+                    insert(e);
+                    e = n;
+                }
+            }
+            m_current = std::max(m_current, now);
+        }
+
+        auto fire() noexcept -> void {
+            auto e = std::exchange(m_ready, nullptr);
+            while (e) {
+                auto next = e->next;
+                e->fn();
+                free_entry(e);
+                m_pending.fetch_sub(1, std::memory_order_release);
+                e = next;
+            }
+        }
+
+        auto sleep() -> void {
+            auto next = next_event();
+            m_sleep_until.store(next);
+            if (m_inbox.load() != nullptr) return;
+            auto has_work = [this] {
+                return m_inbox.load() != nullptr || !m_running.load(std::memory_order_acquire);
+            };
+            if (next == std::numeric_limits<tick_t>::max()) {
+                m_waiter.wait(has_work);
+                return;
+            }
+            auto now = now_tick();
+            if (next <= now) return;
+            auto remaining = std::chrono::microseconds(next - now);
+            if (remaining <= spin_window) {
+                ThisThread::yield();
+                return;
+            }
+            m_waiter.wait_for(remaining - spin_window, has_work);
+        }
+    private:
+        BlockAllocator* m_arena;
+        std::size_t m_stack_size;
+        clock::time_point m_epoch{ clock::now() };
+        // INFO: Only touched by the timer thread.
+        tick_t m_current{0};
+        std::array<std::array<Entry*, slots>, levels> m_slots{};
+        std::array<std::uint64_t, levels> m_bitmap{};
+        Entry* m_ready{nullptr};
+        // INFO: Timers beyond the current window of the top level.
+        Entry* m_overflow{nullptr};
+
+        std::atomic<Entry*> m_inbox{nullptr};
+        // INFO: Tick the timer thread sleeps until; new timers that are due earlier wake it.
+        std::atomic<tick_t> m_sleep_until{0};
+        std::atomic<std::size_t> m_pending{0};
+        std::atomic<bool> m_running{false};
+        std::atomic<bool> m_started{false};
+        std::mutex m_mutex;
+        internal::Waiter m_waiter;
+        Thread m_thread;
+    };
+
+} // namespace tpl
+
+#endif // AMT_TPL_TIMER_WHEEL_HPP
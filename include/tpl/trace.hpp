@@ -0,0 +1,127 @@
+#ifndef AMT_TPL_TRACE_HPP
+#define AMT_TPL_TRACE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <print>
+#include <string_view>
+#include <vector>
+
+// INFO: Define `TPL_ENABLE_TRACE` before including the scheduler to record what the
+// workers run; `Scheduler::dump_trace` writes it as a Chrome trace. Without it the
+// hooks are compiled out and the dump is empty.
+
+namespace tpl {
+
+    enum class TraceKind: std::uint8_t {
+        task,
+        rescheduled,
+        failed,
+        work,
+        park
+    };
+
+    constexpr auto to_string(TraceKind k) noexcept -> std::string_view {
+        switch (k) {
+            case TraceKind::task: return "task";
+            case TraceKind::rescheduled: return "rescheduled";
+            case TraceKind::failed: return "failed";
+            case TraceKind::work: return "work";
+            case TraceKind::park: return "park";
+        }
+    }
+
+    namespace internal {
+        struct TraceRecord {
+            // INFO: Nanoseconds since `trace_now` was first called.
+            std::uint64_t begin;
+            std::uint64_t end;
+            std::uint32_t id;
+            TraceKind kind;
+        };
+
+        inline auto trace_now() noexcept -> std::uint64_t {
+            static auto const epoch = std::chrono::steady_clock::now();
+            return static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - epoch
+                ).count()
+            );
+        }
+
+        // INFO: Single producer ring of the last `capacity` records of a worker. The
+        // worker overwrites the oldest record without waiting for the reader, so
+        // recording is a store and a release increment.
+        struct TraceBuffer {
+            static constexpr std::size_t capacity = std::size_t{1} << 14;
+            static constexpr std::size_t mask = capacity - 1;
+
+            TraceBuffer()
+                : m_records(std::make_unique<TraceRecord[]>(capacity))
+            {}
+
+            auto push(TraceRecord r) noexcept -> void {
+                auto h = m_head.load(std::memory_order_relaxed);
+                m_records[h & mask] = r;
+                m_head.store(h + 1, std::memory_order_release);
+            }
+
+            // INFO: Copies the records in the order they were pushed.
+            // NOTE: It's meant to be called between runs. A worker that records in the
+            // meantime may overwrite the oldest ones; those are dropped.
+            auto snapshot(std::vector<TraceRecord>& out) const -> void {
+                auto h = m_head.load(std::memory_order_acquire);
+                auto first = h > capacity ? h - capacity : 0;
+                auto start = out.size();
+                for (auto i = first; i < h; ++i) out.push_back(m_records[i & mask]);
+                auto now = m_head.load(std::memory_order_acquire);
+                if (now - first >= capacity) {
+                    auto stale = std::min(now - first - capacity + 1, h - first);
+                    out.erase(out.begin() + static_cast<std::ptrdiff_t>(start),
+                              out.begin() + static_cast<std::ptrdiff_t>(start + stale));
+                }
+            }
+
+            auto clear() noexcept -> void {
+                m_head.store(0, std::memory_order_release);
+            }
+        private:
+            std::unique_ptr<TraceRecord[]> m_records;
+            std::atomic<std::size_t> m_head{0};
+        };
+
+        // INFO: Writes the records of each worker as complete events; the worker id is
+        // the thread id. Times are in microseconds.
+        inline auto write_trace(
+            std::ostream& os,
+            std::vector<std::vector<TraceRecord>> const& workers
+        ) -> void {
+            std::print(os, "{{\"traceEvents\":[");
+            auto first = true;
+            for (auto w = 0ul; w < workers.size(); ++w) {
+                std::print(os, "{}\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"worker {}\"}}}}",
+                    first ? "" : ",", w, w);
+                first = false;
+                for (auto const& r: workers[w]) {
+                    std::print(os, ",\n{{\"name\":\"{}\",\"cat\":\"tpl\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+                        to_string(r.kind), w,
+                        static_cast<double>(r.begin) / 1000.0,
+                        static_cast<double>(r.end - r.begin) / 1000.0);
+                    if (r.kind != TraceKind::work && r.kind != TraceKind::park) {
+                        std::print(os, ",\"args\":{{\"id\":{}}}", r.id);
+                    }
+                    std::print(os, "}}");
+                }
+            }
+            std::println(os, "\n]}}");
+        }
+    } // namespace internal
+
+} // namespace tpl
+
+#endif // AMT_TPL_TRACE_HPP
@@ -5,7 +5,13 @@
 #include "task_id.hpp"
 #include "cow.hpp"
 #include "list.hpp"
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <cstring>
+#include <new>
+#include <string>
 #include <type_traits>
 #include <expected>
 #include <utility>
@@ -26,6 +32,21 @@ namespace tpl {
                 }
             }
         };
+
+        static constexpr std::size_t inline_value_size = 64;
+
+        // INFO: Values that live in the slot of the producing task instead of
+        // being allocated.
+        template <typename T>
+        static constexpr bool stores_inline_v =
+            sizeof(T) <= inline_value_size &&
+            alignof(T) <= inline_value_size &&
+            std::is_nothrow_move_constructible_v<T>;
+
+        // INFO: Inline values that can be read by copying them out of the slot.
+        template <typename T>
+        static constexpr bool is_inline_value_v =
+            std::is_trivially_copyable_v<T> && stores_inline_v<T>;
     } // namespace internal
 
     enum class ValueStoreError {
@@ -40,7 +61,12 @@ namespace tpl {
         }
     }
 
-    // NOTE: This is not a thread-safe.
+    // NOTE: Every slot has a single writer, the task that owns it, and any number of
+    // readers. A value becomes visible to the readers once its slot is published,
+    // so `put`, `get`, `consume` and `remove` can run concurrently. `resize`,
+    // `resize_ports` and `clear` must not race with any other call.
+    // Output ports (see `is_port_id`) have their own slots and are otherwise
+    // handled like the value of a task.
     struct ValueStore {
         ValueStore(BlockAllocator* allocator) noexcept
             : m_allocator(allocator)
@@ -49,85 +75,169 @@ namespace tpl {
         ValueStore(ValueStore &&) noexcept = delete;
         ValueStore& operator=(ValueStore const&) noexcept = delete;
         ValueStore& operator=(ValueStore &&) noexcept = delete;
-        ~ValueStore() noexcept = default;
+        ~ValueStore() noexcept {
+            clear();
+            for (auto& v: m_values) delete v.slot;
+            for (auto& v: m_port_values) delete v.slot;
+        }
 
         template <typename T>
             requires (std::is_move_constructible_v<T> || std::is_copy_constructible_v<T>)
         auto put(TaskId task_id, T&& value) -> void {
-            auto id = tid_to_int(task_id);
+            auto e = entry(task_id);
+            if (!e) return;
+            remove(task_id);
 
-            if (id >= m_values.size()) return;
-            auto tmp = m_allocator->alloc<T>();
+            auto& v = *e;
+            v.state.store(State::writing, std::memory_order_relaxed);
+            T* tmp{};
+            if constexpr (internal::stores_inline_v<T>) {
+                // NOTE: Only the owner writes the slot and readers wait for `ready`.
+                if (!v.slot) v.slot = new InlineSlot;
+                tmp = reinterpret_cast<T*>(v.slot->data);
+            } else {
+                tmp = m_allocator->alloc<T>();
+            }
             if constexpr (std::is_move_constructible_v<T>) {
                 new(tmp) T(std::move(value));
             } else {
                 new(tmp) T(value);
             }
 
-            remove(task_id);
-            m_values[id] = Value {
-                .value = tmp,
-                .destroy = internal::ValueStoreDestructor<T>::destroy
-            };
-            m_size.fetch_add(1);
+            v.value = tmp;
+            v.destroy = internal::ValueStoreDestructor<T>::destroy;
+            m_size.fetch_add(1, std::memory_order_relaxed);
+            v.state.store(State::ready, std::memory_order_seq_cst);
+            // INFO: Every consumer gave up before it was published; see `release_reader`.
+            if (v.readers != 0 && v.pending.load(std::memory_order_seq_cst) == 0) remove(task_id);
         }
 
         // std::expected does not allow references so we wrap it in reference wrapper
         template <typename T>
         auto get(TaskId task_id) noexcept -> std::expected<Cow<T>, ValueStoreError> {
-            auto id = tid_to_int(task_id);
+            auto ptr = find<T>(task_id);
+            if (!ptr) return std::unexpected(ptr.error());
+            return Cow<T>(*ptr);
+        }
 
-            if (id >= m_values.size()) return std::unexpected(ValueStoreError::not_found);
-            Value tmp = m_values[id];
+        // INFO: Read-only view of a value that may be shared by several consumers.
+        // std::expected does not allow references so we wrap it in reference wrapper
+        template <typename T>
+        auto view(TaskId task_id) noexcept -> std::expected<std::reference_wrapper<T const>, ValueStoreError> {
+            auto ptr = find<T>(task_id);
+            if (!ptr) return std::unexpected(ptr.error());
+            return std::cref(**ptr);
+        }
 
-            if (!tmp.destroy) {
-                return std::unexpected(ValueStoreError::not_found);
-            }
+        // INFO: Hands the value over to a single consumer without moving it; the
+        // returned `Cow` borrows the slot, so `take` moves the value exactly once.
+        // The moved-from object is destroyed by `remove` or `clear`.
+        template <typename T>
+            requires (std::is_move_constructible_v<T>)
+        auto consume(TaskId task_id) noexcept -> std::expected<Cow<T>, ValueStoreError> {
+            auto ptr = acquire<T>(task_id);
+            if (!ptr) return std::unexpected(ptr.error());
+            return Cow<T>(*ptr);
+        }
 
-            if (internal::ValueStoreDestructor<T>::destroy != tmp.destroy) {
-                return std::unexpected(ValueStoreError::type_mismatch);
-            }
-            auto ptr = reinterpret_cast<T*>(tmp.value);
-            return Cow<T>(ptr);
+        // INFO: `get` and `consume` for callers that know the type statically, e.g.
+        // from a typed tracker; only the publication of the value is checked.
+        template <typename T>
+        auto get_unchecked(TaskId task_id) noexcept -> std::expected<Cow<T>, ValueStoreError> {
+            auto ptr = find<T, false>(task_id);
+            if (!ptr) return std::unexpected(ptr.error());
+            return Cow<T>(*ptr);
         }
 
         template <typename T>
             requires (std::is_move_constructible_v<T>)
-        auto consume(TaskId task_id) noexcept -> std::expected<Cow<T>, ValueStoreError> {
-            auto id = tid_to_int(task_id);
-            if (id >= m_values.size()) return std::unexpected(ValueStoreError::not_found);
-            Value tmp = std::exchange(m_values[id], Value{});
+        auto consume_unchecked(TaskId task_id) noexcept -> std::expected<Cow<T>, ValueStoreError> {
+            auto ptr = acquire<T, false>(task_id);
+            if (!ptr) return std::unexpected(ptr.error());
+            return Cow<T>(*ptr);
+        }
 
-            if (!tmp.destroy) {
-                return std::unexpected(ValueStoreError::not_found);
-            }
+        // INFO: Moves the value straight out of the store and releases the slot.
+        template <typename T>
+            requires (std::is_move_constructible_v<T>)
+        auto take(TaskId task_id) noexcept -> std::expected<T, ValueStoreError> {
+            auto ptr = acquire<T>(task_id);
+            if (!ptr) return std::unexpected(ptr.error());
+            std::expected<T, ValueStoreError> res(std::in_place, std::move(**ptr));
+            remove(task_id);
+            return res;
+        }
 
-            if (internal::ValueStoreDestructor<T>::destroy != tmp.destroy) {
-                return std::unexpected(ValueStoreError::type_mismatch);
+        // INFO: Typed fast path for inline results; the type is known statically
+        // so only the publication of the value is checked.
+        template <typename T>
+            requires (internal::is_inline_value_v<T>)
+        auto get_inline(TaskId task_id) const noexcept -> T const* {
+            auto e = const_cast<ValueStore*>(this)->entry(task_id);
+            if (!e) return nullptr;
+            if (e->state.load(std::memory_order_acquire) != State::ready) return nullptr;
+            return std::launder(reinterpret_cast<T const*>(e->slot->data));
+        }
+
+        // INFO: Gives `task_id` its inline slot ahead of the first `put`, e.g. when
+        // the type of the result is known while the graph is built. Other types
+        // never get one. The slot stays with the entry until the store is destroyed.
+        template <typename T>
+        auto reserve_inline(TaskId task_id) -> void {
+            if constexpr (internal::stores_inline_v<T>) {
+                auto e = entry(task_id);
+                if (e && !e->slot) e->slot = new InlineSlot;
             }
-            m_size.fetch_sub(1);
-            auto ptr = reinterpret_cast<T*>(tmp.value);
-            auto val = std::move(*ptr);
-            m_allocator->dealloc(ptr);
-            return Cow<T>(std::move(val));
         }
 
+        // INFO: Only the owner of the slot or a consumer that took the value may remove it.
         auto remove(TaskId task_id) noexcept -> void {
-            auto id = tid_to_int(task_id);
-            if (id >= m_values.size()) return;
-            Value v = std::exchange(m_values[id], Value{});
-            if (!v.destroy) return;
-            v.destroy(v.value);
-            m_size.fetch_sub(1);
+            auto e = entry(task_id);
+            if (!e) return;
+            auto prev = e->state.exchange(State::empty, std::memory_order_acq_rel);
+            if (prev == State::empty || prev == State::writing) return;
+            release(e);
+            if (prev == State::ready) m_size.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // INFO: Number of consumers of the value of `task_id`; zero means the value
+        // is not reference counted and lives until it's removed or cleared.
+        // It's kept across `clear` since it describes the graph, not the run.
+        auto set_readers(TaskId task_id, std::uint32_t readers) noexcept -> void {
+            auto e = entry(task_id);
+            if (!e) return;
+            e->readers = readers;
+            e->pending.store(readers, std::memory_order_relaxed);
+        }
+
+        // INFO: Called once by every consumer after it finishes, or gives up on the
+        // value, e.g. it was cancelled before the value was published. The last one
+        // frees the value, or what is left of it after it was consumed, instead of
+        // leaving it until `clear`; if the value is not published yet, `put` frees it.
+        auto release_reader(TaskId task_id) noexcept -> void {
+            auto e = entry(task_id);
+            if (!e) return;
+            auto& v = *e;
+            if (v.readers == 0) return;
+            auto left = v.pending.load(std::memory_order_relaxed);
+            do {
+                if (left == 0) return;
+            } while (!v.pending.compare_exchange_weak(
+                left, left - 1,
+                std::memory_order_seq_cst,
+                std::memory_order_relaxed
+            ));
+            if (left != 1) return;
+            // NOTE: Pairs with the check at the end of `put`; at least one of them sees
+            // both the last release and the published value.
+            auto state = v.state.load(std::memory_order_seq_cst);
+            if (state == State::ready || state == State::consumed) remove(task_id);
         }
 
         auto clear() noexcept -> void {
-            m_values.for_each([](Value& v) {
-                if (!v.destroy) return;
-                v.destroy(v.value);
-                v.destroy = nullptr;
-            });
-            m_allocator->reset(true);
+            for (auto& v: m_values) clear_entry(&v);
+            for (auto& v: m_port_values) clear_entry(&v);
+            if (m_allocator) m_allocator->reset(true);
             m_size = 0;
         }
 
@@ -139,23 +249,133 @@ namespace tpl {
             return m_size.load();
         }
 
-        constexpr auto get_type(TaskId task_id) const noexcept {
-            auto id = tid_to_int(task_id);
-            assert(id < m_values.size());
-            return m_values[id].destroy;
+        // INFO: Type tag of the published value or null if there is none.
+        auto get_type(TaskId task_id) const noexcept -> void (*)(void*) {
+            auto e = const_cast<ValueStore*>(this)->entry(task_id);
+            assert(e != nullptr);
+            if (e->state.load(std::memory_order_acquire) != State::ready) return nullptr;
+            return e->destroy;
         }
 
         auto resize(std::size_t sz) {
             m_values.resize(sz);
         }
+
+        auto resize_ports(std::size_t sz) {
+            m_port_values.resize(sz);
+        }
     private:
+        enum class State: std::uint8_t {
+            empty,
+            writing,
+            ready,
+            // INFO: Handed over to a consumer; the object is still alive.
+            consumed
+        };
+
+        struct InlineSlot {
+            alignas(internal::inline_value_size) std::byte data[internal::inline_value_size];
+        };
+
         struct Value {
             void* value{nullptr};
-            void (*destroy)(void*);
+            void (*destroy)(void*){nullptr};
+            std::atomic<State> state{State::empty};
+            // INFO: See `set_readers`; `pending` is reloaded from it by `clear`.
+            std::uint32_t readers{0};
+            std::atomic<std::uint32_t> pending{0};
+            // INFO: Storage for `internal::stores_inline_v` values; only entries that
+            // held one have it. Owned by the store.
+            InlineSlot* slot{nullptr};
+
+            Value() noexcept = default;
+            Value(Value const&) = delete;
+            Value(Value && other) noexcept
+                : value(other.value)
+                , destroy(other.destroy)
+                , state(other.state.load(std::memory_order_relaxed))
+                , readers(other.readers)
+                , pending(other.pending.load(std::memory_order_relaxed))
+                , slot(std::exchange(other.slot, nullptr))
+            {}
+            Value& operator=(Value const&) = delete;
+            Value& operator=(Value && other) noexcept {
+                value = other.value;
+                destroy = other.destroy;
+                state.store(other.state.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                readers = other.readers;
+                pending.store(other.pending.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                slot = std::exchange(other.slot, nullptr);
+                return *this;
+            }
+            ~Value() noexcept = default;
         };
+
+        auto entry(TaskId task_id) noexcept -> Value* {
+            if (is_port_id(task_id)) {
+                auto p = tid_to_port(task_id);
+                if (p >= m_port_values.size()) return nullptr;
+                return &m_port_values[p];
+            }
+            auto id = tid_to_int(task_id);
+            if (id >= m_values.size()) return nullptr;
+            return &m_values[id];
+        }
+
+        template <typename T, bool Checked = true>
+        auto find(TaskId task_id) noexcept -> std::expected<T*, ValueStoreError> {
+            auto e = entry(task_id);
+            if (!e) return std::unexpected(ValueStoreError::not_found);
+            auto const& v = *e;
+            if (v.state.load(std::memory_order_acquire) != State::ready) {
+                return std::unexpected(ValueStoreError::not_found);
+            }
+
+            if constexpr (Checked) {
+                if (internal::ValueStoreDestructor<T>::destroy != v.destroy) {
+                    return std::unexpected(ValueStoreError::type_mismatch);
+                }
+            } else {
+                assert(internal::ValueStoreDestructor<T>::destroy == v.destroy && "the value has another type");
+            }
+            return std::launder(reinterpret_cast<T*>(v.value));
+        }
+
+        // INFO: Hands the published value over to a single consumer.
+        template <typename T, bool Checked = true>
+        auto acquire(TaskId task_id) noexcept -> std::expected<T*, ValueStoreError> {
+            auto ptr = find<T, Checked>(task_id);
+            if (!ptr) return ptr;
+            auto expected = State::ready;
+            if (!entry(task_id)->state.compare_exchange_strong(
+                expected, State::consumed,
+                std::memory_order_acquire,
+                std::memory_order_relaxed
+            )) {
+                return std::unexpected(ValueStoreError::not_found);
+            }
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+            return ptr;
+        }
+
+        auto release(Value* e) noexcept -> void {
+            auto& v = *e;
+            v.destroy(v.value);
+            if (!v.slot || v.value != v.slot->data) m_allocator->dealloc(v.value);
+            v.value = nullptr;
+            v.destroy = nullptr;
+        }
+
+        auto clear_entry(Value* e) noexcept -> void {
+            auto prev = e->state.exchange(State::empty, std::memory_order_relaxed);
+            if (prev == State::ready || prev == State::consumed) release(e);
+            e->pending.store(e->readers, std::memory_order_relaxed);
+        }
     private:
         BlockAllocator* m_allocator{nullptr};
         BlockSizedList<Value> m_values;
+        // INFO: Indexed by `tid_to_port`.
+        BlockSizedList<Value> m_port_values;
         std::atomic<std::size_t> m_size{0};
     };
 
@@ -1,8 +1,10 @@
 #ifndef AMT_TPL_WAITER_HPP
 #define AMT_TPL_WAITER_HPP
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 namespace tpl::internal {
 
@@ -47,6 +49,80 @@ namespace tpl::internal {
         }
     };
 
+    // INFO: Eventcount on top of `std::atomic::wait` (futex on Linux). A waiter announces
+    // itself with `prepare_wait`, re-checks its condition and then either cancels or
+    // commits; the notifier only touches the epoch if someone is waiting, so a notify
+    // without sleepers costs a fence and a load.
+    //
+    //  Waiter                              Notifier
+    //  key = prepare_wait()                <publish the state>
+    //  if (cond()) cancel_wait()           notify(n)
+    //  else commit_wait(key)
+    struct EventCount {
+        using key_t = std::uint32_t;
+
+        auto prepare_wait() noexcept -> key_t {
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            return m_epoch.load(std::memory_order_seq_cst);
+        }
+
+        auto cancel_wait() noexcept -> void {
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        auto commit_wait(key_t key) noexcept -> void {
+            while (m_epoch.load(std::memory_order_acquire) == key) {
+                m_epoch.wait(key, std::memory_order_acquire);
+            }
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // INFO: Wakes at most `n` sleepers.
+        auto notify(std::size_t n) noexcept -> void {
+            if (n == 0) return;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto waiters = m_waiters.load(std::memory_order_relaxed);
+            if (waiters == 0) return;
+            m_epoch.fetch_add(1, std::memory_order_release);
+            if (n >= waiters) {
+                m_epoch.notify_all();
+                return;
+            }
+            for (auto i = 0ul; i < n; ++i) m_epoch.notify_one();
+        }
+
+        auto notify_all() noexcept -> void {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_waiters.load(std::memory_order_relaxed) == 0) return;
+            m_epoch.fetch_add(1, std::memory_order_release);
+            m_epoch.notify_all();
+        }
+
+        // INFO: Returns the number of times it has slept.
+        template <typename Fn>
+        auto wait(Fn&& cond) noexcept -> std::size_t {
+            std::size_t sleeps{0};
+            while (!cond()) {
+                auto key = prepare_wait();
+                if (cond()) {
+                    cancel_wait();
+                    break;
+                }
+                commit_wait(key);
+                ++sleeps;
+            }
+            return sleeps;
+        }
+
+        constexpr auto waiters() const noexcept -> std::size_t {
+            return m_waiters.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<key_t> m_epoch{0};
+        std::atomic<key_t> m_waiters{0};
+    };
+
 } // namespace tpl::internal
 
 #endif // AMT_TPL_WAITER_HPP
@@ -0,0 +1,115 @@
+#ifndef AMT_TPL_WORK_STEALING_DEQUE_HPP
+#define AMT_TPL_WORK_STEALING_DEQUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include "atomic.hpp"
+#include "maths.hpp"
+
+namespace tpl {
+
+    // INFO: Bounded Chase-Lev deque (https://fzn.fr/readings/ppopp13.pdf).
+    // Only the owner thread is allowed to call `push` and `pop`; any thread can
+    // call `steal`. The owner works on the bottom (LIFO) which keeps the recently
+    // produced work hot in its cache, while thieves take from the top (FIFO).
+    // When the deque is full `push` fails and the caller is expected to fallback
+    // to a shared queue.
+    template <typename T, std::size_t N>
+        requires (maths::is_non_zero_power_of_two(N) && std::is_trivially_copyable_v<T>)
+    struct WorkStealingDeque {
+        using value_type = T;
+        using size_type = std::size_t;
+        using index_t = std::int64_t;
+        static constexpr size_type capacity = N;
+
+        constexpr WorkStealingDeque() noexcept = default;
+        WorkStealingDeque(WorkStealingDeque const&) = delete;
+        WorkStealingDeque(WorkStealingDeque &&) = delete;
+        WorkStealingDeque& operator=(WorkStealingDeque const&) = delete;
+        WorkStealingDeque& operator=(WorkStealingDeque &&) = delete;
+        ~WorkStealingDeque() noexcept = default;
+
+        // INFO: Owner only
+        auto push(value_type val) noexcept -> bool {
+            auto b = m_bottom.load(std::memory_order_relaxed);
+            auto t = m_top.load(std::memory_order_acquire);
+            if (b - t >= static_cast<index_t>(N)) return false;
+            m_data[index(b)].store(val, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // INFO: Owner only
+        auto pop() noexcept -> std::optional<value_type> {
+            auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto t = m_top.load(std::memory_order_relaxed);
+
+            if (t > b) {
+                // Empty
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+
+            auto val = m_data[index(b)].load(std::memory_order_relaxed);
+            if (t != b) return val;
+
+            // INFO: Last element; race against the thieves.
+            auto won = m_top.compare_exchange_strong(
+                t, t + 1,
+                std::memory_order_seq_cst,
+                std::memory_order_relaxed
+            );
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) return std::nullopt;
+            return val;
+        }
+
+        auto steal() noexcept -> std::optional<value_type> {
+            auto t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto b = m_bottom.load(std::memory_order_acquire);
+            if (t >= b) return std::nullopt;
+
+            auto val = m_data[index(t)].load(std::memory_order_relaxed);
+            if (!m_top.compare_exchange_strong(
+                t, t + 1,
+                std::memory_order_seq_cst,
+                std::memory_order_relaxed
+            )) {
+                // Lost the race with another thief or the owner.
+                return std::nullopt;
+            }
+            return val;
+        }
+
+        // INFO: It's an approximation if called from a thread other than the owner.
+        auto size() const noexcept -> size_type {
+            auto b = m_bottom.load(std::memory_order_relaxed);
+            auto t = m_top.load(std::memory_order_relaxed);
+            return b > t ? static_cast<size_type>(b - t) : 0;
+        }
+
+        auto empty() const noexcept -> bool {
+            return size() == 0;
+        }
+
+    private:
+        static constexpr auto index(index_t i) noexcept -> size_type {
+            return static_cast<size_type>(i) & (N - 1);
+        }
+    private:
+        alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<index_t> m_top{0};
+        alignas(atomic::internal::hardware_destructive_interference_size) std::atomic<index_t> m_bottom{0};
+        alignas(atomic::internal::hardware_destructive_interference_size) std::array<std::atomic<value_type>, N> m_data{};
+    };
+
+} // namespace tpl
+
+#endif // AMT_TPL_WORK_STEALING_DEQUE_HPP
@@ -1,26 +1,47 @@
 #ifndef AMT_TPL_WORKER_POOL_HPP
 #define AMT_TPL_WORKER_POOL_HPP
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
 #include <vector>
+#include "atomic.hpp"
+#include "scheduler_config.hpp"
+#include "stats.hpp"
 #include "thread.hpp"
+#include "trace.hpp"
 #include "waiter.hpp"
 
 namespace tpl {
 
     struct Scheduler;
 
+    // INFO: A pool of workers that can be shared by multiple schedulers. A scheduler
+    // attaches itself for the duration of `run`, so concurrent runs on different
+    // schedulers execute on the same threads, and each graph still tracks its own
+    // completion. Threads are spawned on demand, up to `size()`, the first time
+    // there is more ready work than parked workers. The pool must outlive the
+    // schedulers that use it.
     struct WorkerPool {
-        using thread_t = std::thread;
+        using thread_t = Thread;
+        static constexpr std::size_t max_schedulers = 64;
 
-        WorkerPool(
-            Scheduler& schedular,
-            std::size_t nthreads = tpl::hardware_max_parallism()
-        ) : m_parent(schedular)
+        explicit WorkerPool(SchedulerConfig config = {})
+            : m_config(resolve(std::move(config)))
+            , m_nthreads(m_config.nthreads)
+            , m_workers(std::make_unique<WorkerState[]>(m_nthreads))
         {
-            for (auto i = 0ul; i < nthreads; ++i) {
-                m_threads.emplace_back(&WorkerPool::do_work, this, i);
-            }
+            m_threads.reserve(m_nthreads);
         }
+        explicit WorkerPool(std::size_t nthreads, IdlePolicy policy = {})
+            : WorkerPool(SchedulerConfig{ .nthreads = nthreads, .idle = policy, .use_env = false })
+        {}
         WorkerPool(WorkerPool const&) = delete;
         WorkerPool(WorkerPool &&) = delete;
         WorkerPool& operator=(WorkerPool const&) = delete;
@@ -29,26 +50,235 @@ namespace tpl {
             stop();
         }
 
+        // INFO: The threads are joined outside of the lock; a worker may still be
+        // spawning its peers from `wake` until it sees the pool stopped.
         auto stop() -> void {
-            waiter.notify_all([this] {
+            auto threads = std::vector<thread_t>{};
+            {
+                std::lock_guard lock(m_mutex);
                 m_is_running.store(false);
-            });
-            for(auto& t: m_threads) {
-                t.join();
+                threads = std::move(m_threads);
+                m_threads.clear();
+            }
+            waiter.notify_all();
+            for(auto& t: threads) {
+                if (t.joinable()) t.join();
             }
         }
 
         constexpr auto is_running() const noexcept { return m_is_running.load(); }
 
-        internal::Waiter waiter;
+        constexpr auto size() const noexcept -> std::size_t { return m_nthreads; }
+
+        // INFO: Number of threads spawned so far.
+        constexpr auto spawned() const noexcept -> std::size_t {
+            return m_spawned.load(std::memory_order_acquire);
+        }
+
+        // INFO: Returns the pool that owns the calling thread or `nullptr` if the
+        // thread is not a worker.
+        static auto current() noexcept -> WorkerPool* { return s_current; }
+
+        constexpr auto idle_policy() const noexcept -> IdlePolicy { return m_config.idle; }
+
+        constexpr auto config() const noexcept -> SchedulerConfig const& { return m_config; }
+
+        // INFO: Runs ready work of the attached schedulers on the calling worker until
+        // `done` holds, so a worker waiting on a result stays useful. It parks like an
+        // idle worker when there is nothing to run; whoever makes `done` true has to
+        // notify `waiter`. Returns early if the pool is stopped.
+        template <typename Fn>
+        auto help_until(Fn&& done) -> void;
+
+        // INFO: Writes the tasks, queued work and parks recorded by each worker as Chrome
+        // trace JSON, which Perfetto opens as well. Only the latest records of each
+        // worker are kept; see `internal::TraceBuffer`.
+        auto dump_trace(std::ostream& os) const -> void {
+            auto workers = std::vector<std::vector<internal::TraceRecord>>(m_nthreads);
+            #ifdef TPL_ENABLE_TRACE
+            for (auto i = 0ul; i < m_nthreads; ++i) m_workers[i].trace.snapshot(workers[i]);
+            #endif
+            internal::write_trace(os, workers);
+        }
+
+        auto clear_trace() noexcept -> void {
+            #ifdef TPL_ENABLE_TRACE
+            for (auto i = 0ul; i < m_nthreads; ++i) m_workers[i].trace.clear();
+            #endif
+        }
+
+        // INFO: Idle workers park here; it's notified once per task that becomes ready.
+        internal::EventCount waiter;
     private:
         friend struct TaskToken;
+        friend struct Scheduler;
+
+        // INFO: Each worker publishes the scheduler it's looking at (a hazard pointer)
+        // so that `detach` can wait until no worker touches the scheduler anymore.
+        struct alignas(atomic::internal::hardware_destructive_interference_size) WorkerState {
+            std::atomic<Scheduler*> hazard{nullptr};
+            // INFO: Only touched by the owner; rotates the first scheduler to poll.
+            std::size_t next{0};
+            #ifdef TPL_ENABLE_TRACE
+            internal::TraceBuffer trace{};
+            #endif
+            // INFO: Only the idle counters are used; the rest are kept per scheduler.
+            internal::WorkerCounters stats{};
+        };
+
+        static auto resolve(SchedulerConfig config) -> SchedulerConfig {
+            if (config.use_env) config.apply_env();
+            config.nthreads = config.threads();
+            return config;
+        }
+
+        // INFO: Pins and names the calling worker.
+        auto setup_thread(std::size_t id) const -> void {
+            if (auto const* cpus = m_config.affinity_of(id)) {
+                (void)ThisThread::set_affinity(*cpus);
+            }
+            if (m_config.name_prefix.empty()) return;
+            auto name = m_config.name_prefix + std::to_string(id);
+            #ifdef __linux__
+            if (name.size() > 15) name.resize(15);
+            #endif
+            (void)ThisThread::set_name(name);
+        }
+
+        // INFO: Blocks while all the slots are taken.
+        auto attach(Scheduler& s) -> std::size_t {
+            while (true) {
+                for (auto i = 0ul; i < max_schedulers; ++i) {
+                    Scheduler* expected = nullptr;
+                    if (!m_slots[i].compare_exchange_strong(expected, &s)) continue;
+                    auto used = m_used.load();
+                    while (used < i + 1 && !m_used.compare_exchange_weak(used, i + 1));
+                    return i;
+                }
+                ThisThread::yield();
+            }
+        }
+
+        auto detach(std::size_t slot) -> void {
+            auto* s = m_slots[slot].exchange(nullptr);
+            for (auto i = 0ul; i < m_nthreads; ++i) {
+                while (m_workers[i].hazard.load() == s) ThisThread::yield();
+            }
+        }
+
+        // INFO: Wakes `n` workers and spawns the missing ones if there are not
+        // enough parked workers.
+        auto wake(std::size_t n) -> void {
+            if (n == 0) return;
+            if (m_spawned.load(std::memory_order_acquire) < m_nthreads) {
+                auto parked = waiter.waiters();
+                if (parked < n) spawn(n - parked);
+            }
+            waiter.notify(n);
+        }
+
+        auto spawn(std::size_t n) -> void {
+            if (!m_is_running.load()) return;
+            std::lock_guard lock(m_mutex);
+            if (!m_is_running.load()) return;
+            auto target = std::min(m_nthreads, m_threads.size() + n);
+            while (m_threads.size() < target) {
+                m_threads.emplace_back(m_config.stack_size, [this, id = m_threads.size()] {
+                    do_work(id);
+                });
+            }
+            m_spawned.store(m_threads.size(), std::memory_order_release);
+        }
+
+        auto poll(std::size_t worker, bool run) -> bool;
+
+        #ifdef TPL_ENABLE_TRACE
+        // INFO: Records an event of the calling worker; other threads are ignored.
+        auto trace(internal::TraceRecord r) noexcept -> void {
+            if (s_current != this) return;
+            m_workers[ThisThread::pool_id()].trace.push(r);
+        }
+        #endif
+
         void do_work(std::size_t thread_id);
+
+        // INFO: Waits for `has_work` according to the idle policy and counts the time.
+        template <typename Fn>
+        auto idle(Fn&& has_work) -> void;
+
+        template <typename Fn>
+        auto park(internal::WorkerCounters& stats, Fn& has_work) -> void;
     private:
         std::vector<thread_t> m_threads;
+        std::mutex m_mutex;
         std::atomic<bool> m_is_running{true};
-        Scheduler& m_parent;
+        std::atomic<std::size_t> m_spawned{0};
+        SchedulerConfig m_config;
+        std::size_t m_nthreads;
+        std::unique_ptr<WorkerState[]> m_workers;
+        std::array<std::atomic<Scheduler*>, max_schedulers> m_slots{};
+        // INFO: High-water mark of the used slots; bounds the polling.
+        std::atomic<std::size_t> m_used{0};
+        static thread_local WorkerPool* s_current;
+        // INFO: Depth of `help_until` on the calling worker. The time of the nested
+        // work is already counted by the task that is waiting.
+        static thread_local std::size_t s_helping;
     };
+
+    inline thread_local WorkerPool* WorkerPool::s_current = nullptr;
+    inline thread_local std::size_t WorkerPool::s_helping = 0;
+
+    template <typename Fn>
+    inline auto WorkerPool::idle(Fn&& has_work) -> void {
+        auto& stats = m_workers[ThisThread::pool_id()].stats;
+        // INFO: Waiting inside `help_until` is part of the busy time of the task.
+        if (s_helping) return park(stats, has_work);
+        auto start = std::chrono::steady_clock::now();
+        park(stats, has_work);
+        internal::WorkerCounters::add(stats.idle_ns, std::chrono::steady_clock::now() - start);
+    }
+
+    template <typename Fn>
+    inline auto WorkerPool::park(internal::WorkerCounters& stats, Fn& has_work) -> void {
+        auto const& policy = m_config.idle;
+        for (auto i = 0ul; i < policy.spin; ++i) {
+            if (has_work()) return;
+            ThisThread::pause();
+        }
+        for (auto i = 0ul; i < policy.yield; ++i) {
+            if (has_work()) return;
+            ThisThread::yield();
+        }
+        if (!policy.park) return;
+        #ifdef TPL_ENABLE_TRACE
+        auto begin = internal::trace_now();
+        auto sleeps = waiter.wait(has_work);
+        trace({ .begin = begin, .end = internal::trace_now(), .id = 0, .kind = TraceKind::park });
+        #else
+        auto sleeps = waiter.wait(has_work);
+        #endif
+        if (sleeps == 0) return;
+        internal::WorkerCounters::add(stats.parks);
+        internal::WorkerCounters::add(stats.wakeups, sleeps);
+    }
+
+    template <typename Fn>
+    inline auto WorkerPool::help_until(Fn&& done) -> void {
+        assert(s_current == this && "only a worker of the pool can help");
+        auto worker = ThisThread::pool_id();
+        // INFO: The tasks it runs may change the priority of the thread.
+        auto priority = ThisThread::s_priority;
+        auto has_work = [this, worker, &done] {
+            return done() || !m_is_running.load(std::memory_order_acquire) || poll(worker, false);
+        };
+        ++s_helping;
+        while (!done() && m_is_running.load(std::memory_order_acquire)) {
+            if (poll(worker, true)) continue;
+            idle(has_work);
+        }
+        --s_helping;
+        (void)ThisThread::set_priority(priority);
+    }
 } // namespace tpl
 
 #endif // AMT_TPL_WORKER_POOL_HPP
@@ -0,0 +1,153 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tpl/scheduler.hpp"
+#include "tpl/channel.hpp"
+
+using namespace tpl;
+using namespace std::chrono_literals;
+
+namespace {
+    auto twice(int x) -> Coro<int> {
+        co_await sleep_for(1ms);
+        co_return x * 2;
+    }
+} // namespace
+
+TEST_CASE("Coroutine Tasks", "[coro]" ) {
+    GIVEN("A coroutine feeding a plain task") {
+        auto s = Scheduler(2);
+        auto a = s.add_task([]() -> Coro<int> {
+            co_await sleep_for(2ms);
+            auto x = co_await twice(10);
+            co_return x + 1;
+        });
+        auto b = s.add_task([a](TaskToken& t) {
+            return t.arg<int>(a.id)->ref() + 1;
+        });
+        REQUIRE(b.deps_on(a).has_value());
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(s.get_result(b) == 22);
+        }
+
+        WHEN("It is compiled and run many times") {
+            REQUIRE(s.compile().has_value());
+            for (auto i = 0; i < 3; ++i) {
+                REQUIRE(s.run().has_value());
+                REQUIRE(s.get_result(b) == 22);
+            }
+        }
+    }
+
+    GIVEN("Many more sleeping coroutines than workers") {
+        constexpr auto n = 512;
+        auto s = Scheduler(2);
+        auto done = std::atomic<int>{0};
+        for (auto i = 0; i < n; ++i) {
+            s.add_task([&done]() -> Coro<> {
+                for (auto j = 0; j < 4; ++j) co_await sleep_for(5ms);
+                done.fetch_add(1);
+            });
+        }
+
+        WHEN("It is run") {
+            auto start = std::chrono::steady_clock::now();
+            REQUIRE(s.run().has_value());
+            // Blocking the workers would take n * 20ms / 2.
+            REQUIRE(std::chrono::steady_clock::now() - start < 2s);
+            REQUIRE(done.load() == n);
+        }
+    }
+
+    GIVEN("Producers and consumers on a small channel") {
+        constexpr auto producers = 8;
+        constexpr auto per_producer = 200;
+        auto s = Scheduler(2);
+        auto ch = bounded_channel_t<int, 4>{};
+        auto sum = std::atomic<long>{0};
+        auto left = std::atomic<int>{producers};
+        auto failed = std::atomic<int>{0};
+
+        for (auto p = 0; p < producers; ++p) {
+            s.add_task([&ch, &left, &failed]() -> Coro<> {
+                for (auto i = 1; i <= per_producer; ++i) {
+                    if (!co_await ch.async_send(i)) failed.fetch_add(1);
+                }
+                if (left.fetch_sub(1) == 1) ch.close();
+            });
+        }
+        // More consumers than workers; each one would block a worker otherwise.
+        for (auto c = 0; c < 4; ++c) {
+            s.add_task([&ch, &sum]() -> Coro<> {
+                while (auto v = co_await ch.async_receive()) {
+                    sum.fetch_add(*v);
+                }
+            });
+        }
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(failed.load() == 0);
+            REQUIRE(sum.load() == producers * (per_producer * (per_producer + 1) / 2));
+        }
+    }
+
+    GIVEN("A coroutine awaiting queued work") {
+        auto s = Scheduler(2);
+        auto a = s.add_task([](TaskToken& t) -> Coro<std::string> {
+            auto v = co_await t.awaitable_queue_work([] noexcept { return 41; });
+            co_return std::to_string(v + 1);
+        });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(s.get_result(a) == "42");
+        }
+    }
+
+    GIVEN("A coroutine sleeping past the deadline") {
+        auto s = Scheduler(2);
+        auto slow = std::atomic<bool>{true};
+        auto a = s.add_task([&slow]() -> Coro<int> {
+            if (slow.load()) co_await sleep_for(10s);
+            co_return 42;
+        });
+        REQUIRE(s.compile().has_value());
+
+        WHEN("It is run with a deadline and then without one") {
+            auto start = std::chrono::steady_clock::now();
+            auto res = s.run_for(20ms);
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == SchedulerError::deadline_exceeded);
+            // It is cancelled at the deadline instead of when the timer fires.
+            REQUIRE(std::chrono::steady_clock::now() - start < 5s);
+            REQUIRE(s.get_result(a).error() == ValueStoreError::not_found);
+
+            slow = false;
+            REQUIRE(s.run().has_value());
+            REQUIRE(s.get_result(a) == 42);
+        }
+    }
+
+    #ifdef __cpp_exceptions
+    GIVEN("A coroutine that throws after it was resumed") {
+        auto s = Scheduler(2);
+        s.add_task([]() -> Coro<int> {
+            co_await sleep_for(1ms);
+            throw std::runtime_error("failed");
+            co_return 0;
+        });
+
+        WHEN("It is run") {
+            REQUIRE_THROWS_AS(s.run(), std::runtime_error);
+        }
+    }
+    #endif
+}
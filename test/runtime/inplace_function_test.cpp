@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "tpl/allocator.hpp"
+#include "tpl/inplace_function.hpp"
+
+using namespace tpl;
+
+namespace {
+    struct Counted {
+        int* destroyed;
+        std::array<std::byte, 24> pad{};
+
+        Counted(int* d) noexcept : destroyed(d) {}
+        Counted(Counted const&) = delete;
+        Counted(Counted && other) noexcept : destroyed(std::exchange(other.destroyed, nullptr)) {}
+        Counted& operator=(Counted const&) = delete;
+        Counted& operator=(Counted &&) = delete;
+        ~Counted() { if (destroyed) ++*destroyed; }
+    };
+}
+
+TEST_CASE("Inplace Function", "[inplace_function]" ) {
+    WHEN("An empty function is constructed") {
+        auto fn = InplaceFunction<int()>{};
+        REQUIRE(!fn);
+        REQUIRE(!fn.is_spilled());
+    }
+
+    GIVEN("A small capture") {
+        auto x = 41;
+        auto fn = InplaceFunction<int(int)>([x](int y) { return x + y; });
+        REQUIRE(fn);
+        REQUIRE(!fn.is_spilled());
+        REQUIRE(fn(1) == 42);
+
+        WHEN("The function is moved") {
+            auto other = std::move(fn);
+            REQUIRE(!fn);
+            REQUIRE(other(2) == 43);
+        }
+    }
+
+    GIVEN("A move-only capture") {
+        auto fn = InplaceFunction<int()>([p = std::make_unique<int>(7)] { return *p; });
+        REQUIRE(!fn.is_spilled());
+        REQUIRE(fn() == 7);
+    }
+
+    GIVEN("A capture bigger than the inline buffer") {
+        auto big = std::array<int, 32>{};
+        big[31] = 5;
+
+        WHEN("No arena is given") {
+            auto fn = InplaceFunction<int()>([big] { return big[31]; });
+            REQUIRE(fn.is_spilled());
+            auto other = std::move(fn);
+            REQUIRE(other() == 5);
+        }
+
+        WHEN("An arena is given") {
+            auto arena = BlockAllocator{};
+            auto fn = InplaceFunction<int()>([big] { return big[31]; }, &arena);
+            REQUIRE(fn.is_spilled());
+            REQUIRE(arena.nblocks() == 1);
+            REQUIRE(fn() == 5);
+        }
+    }
+
+    GIVEN("A target with a destructor") {
+        auto destroyed = 0;
+        {
+            auto fn = InplaceFunction<void()>([c = Counted(&destroyed)] {});
+            auto other = std::move(fn);
+            other = InplaceFunction<void()>{};
+            REQUIRE(destroyed == 1);
+        }
+        REQUIRE(destroyed == 1);
+
+        {
+            auto big = std::array<std::byte, 128>{};
+            auto fn = InplaceFunction<void()>([c = Counted(&destroyed), big] {});
+            REQUIRE(fn.is_spilled());
+        }
+        REQUIRE(destroyed == 2);
+    }
+}
@@ -58,6 +58,14 @@ TEST_CASE("Block Sized List", "[block_sized_list]" ) {
                 REQUIRE(l[i] == i);
             }
 
+            auto count = 0ul;
+            l.for_each([&count](int v, std::size_t i) {
+                INFO(std::format("[{}]: {} == {}", i, v, i));
+                REQUIRE(static_cast<std::size_t>(v) == i);
+                ++count;
+            });
+            REQUIRE(count == l.size());
+
             l.clear();
             REQUIRE(l.size() == 0);
             REQUIRE(l.nblocks() == 0);
@@ -85,6 +85,25 @@ TEST_CASE("Thread Safe Queue", "[queue]" ) {
         REQUIRE(q.empty() == false);
     }
 
+    WHEN("A range is pushed") {
+        auto q = Queue<int>{};
+        q.push(-1);
+        std::array<int, 300> items{};
+        for (auto i = 0ul; i < items.size(); ++i) items[i] = static_cast<int>(i);
+        REQUIRE(q.push_range(items));
+        // The batch fills its own nodes behind the head.
+        REQUIRE(q.nodes() == 1 + (items.size() + Queue<int>::block_size - 1) / Queue<int>::block_size);
+        REQUIRE(q.size() == items.size() + 1);
+
+        REQUIRE(q.pop() == -1);
+        for (auto i: items) {
+            INFO(std::format("item: {}", i));
+            REQUIRE(q.pop() == i);
+        }
+        REQUIRE(!q.pop());
+        REQUIRE(q.empty());
+    }
+
     GIVEN("A queue") {
         using type = std::pair<std::size_t, int>;
         auto q = Queue<type*>{};
@@ -94,8 +113,15 @@ TEST_CASE("Thread Safe Queue", "[queue]" ) {
 
         auto fn = [&q, &finshed](std::size_t id, int size) {
             for (auto i = 0; i < size; ++i) {
-                auto item = new type(id, i);
-                q.push(item);
+                // Every other thread pushes its items in batches.
+                if (id % 2 == 1 && i + 4 <= size) {
+                    std::array<type*, 4> batch{};
+                    for (auto k = 0; k < 4; ++k) batch[k] = new type(id, i + k);
+                    q.push_range(batch);
+                    i += 3;
+                } else {
+                    q.push(new type(id, i));
+                }
                 std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 10));
             }
             finshed.fetch_add(1);
@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "tpl/reactor.hpp"
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace tpl;
+using namespace std::chrono_literals;
+
+TEST_CASE("Reactor", "[reactor]" ) {
+    WHEN("An invalid descriptor is watched") {
+        auto r = Reactor{};
+        auto res = r.watch(-1, IoEvent::readable, [] noexcept {});
+        REQUIRE(!res.has_value());
+        REQUIRE(r.pending() == 0);
+    }
+
+#ifdef __linux__
+    GIVEN("A pipe") {
+        int fds[2];
+        REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+        auto r = Reactor{};
+        auto calls = std::atomic<int>{0};
+
+        WHEN("The read end is watched before anything is written") {
+            REQUIRE(r.watch(fds[0], IoEvent::readable, [&calls] noexcept { calls.fetch_add(1); }).has_value());
+            REQUIRE(r.pending() == 1);
+            std::this_thread::sleep_for(10ms);
+            REQUIRE(calls.load() == 0);
+
+            char c = 'x';
+            REQUIRE(::write(fds[1], &c, 1) == 1);
+            while (r.pending() != 0) std::this_thread::sleep_for(1ms);
+            REQUIRE(calls.load() == 1);
+
+            // One shot: it has to be watched again for the next event.
+            REQUIRE(r.watch(fds[0], IoEvent::readable, [&calls] noexcept { calls.fetch_add(1); }).has_value());
+            while (r.pending() != 0) std::this_thread::sleep_for(1ms);
+            REQUIRE(calls.load() == 2);
+        }
+
+        WHEN("The write end is watched") {
+            REQUIRE(r.watch(fds[1], IoEvent::writable, [&calls] noexcept { calls.fetch_add(1); }).has_value());
+            while (r.pending() != 0) std::this_thread::sleep_for(1ms);
+            REQUIRE(calls.load() == 1);
+        }
+
+        WHEN("A descriptor is watched twice") {
+            REQUIRE(r.watch(fds[0], IoEvent::readable, [] noexcept {}).has_value());
+            auto res = r.watch(fds[0], IoEvent::readable, [] noexcept {});
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == ReactorError::busy);
+            REQUIRE(r.pending() == 1);
+        }
+
+        WHEN("A waiter is removed") {
+            REQUIRE(r.watch(fds[0], IoEvent::readable, [&calls] noexcept { calls.fetch_add(1); }).has_value());
+            REQUIRE(r.unwatch(fds[0]));
+            REQUIRE(!r.unwatch(fds[0]));
+            REQUIRE(calls.load() == 1);
+            REQUIRE(r.pending() == 0);
+        }
+
+        r.stop();
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+#endif
+}
@@ -0,0 +1,901 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <print>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <variant>
+#include <vector>
+#include "tpl/scheduler.hpp"
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace tpl;
+
+namespace {
+    template <typename A>
+    concept joinable_twice = requires (A& a) { when_all(a, a); };
+} // namespace
+
+TEST_CASE("Scheduler", "[scheduler]" ) {
+    GIVEN("A diamond graph") {
+        auto s = Scheduler(2);
+        std::atomic<int> calls{0};
+
+        auto a = s.add_task([&calls] { ++calls; return 1; });
+        auto b = s.add_task([&calls, a](TaskToken& t) {
+            ++calls;
+            return t.arg<int>(a.id)->ref() + 1;
+        });
+        auto c = s.add_task([&calls, a](TaskToken& t) {
+            ++calls;
+            return t.arg<int>(a.id)->ref() + 2;
+        });
+        auto d = s.add_task([&calls, b, c](TaskToken& t) {
+            ++calls;
+            return t.arg<int>(b.id)->take() + t.arg<int>(c.id)->take();
+        });
+        REQUIRE(b.deps_on(a).has_value());
+        REQUIRE(c.deps_on(a).has_value());
+        REQUIRE(d.deps_on(b, c).has_value());
+
+        WHEN("It is run once") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(calls == 4);
+            REQUIRE(s.get_result<int>(d) == 5);
+        }
+
+        WHEN("It is compiled and run many times") {
+            REQUIRE(s.compile().has_value());
+            REQUIRE(s.is_compiled());
+            for (auto i = 1; i <= 10; ++i) {
+                INFO(std::format("Run: {}", i));
+                REQUIRE(s.run().has_value());
+                REQUIRE(calls == 4 * i);
+                REQUIRE(s.get_result<int>(d) == 5);
+            }
+        }
+
+        WHEN("A task is added after compiling") {
+            REQUIRE(s.compile().has_value());
+            auto e = s.add_task([&calls] { ++calls; });
+            REQUIRE(!s.is_compiled());
+            REQUIRE(e.deps_on(d).has_value());
+            REQUIRE(s.run().has_value());
+            REQUIRE(calls == 5);
+        }
+    }
+
+    GIVEN("A compiled graph with a task that stops") {
+        auto s = Scheduler(2);
+        std::atomic<int> calls{0};
+        std::atomic<bool> should_stop{true};
+
+        auto a = s.add_task([&](TaskToken& t) {
+            ++calls;
+            if (should_stop) t.stop();
+        });
+        auto b = s.add_task([&calls] { ++calls; });
+        REQUIRE(b.deps_on(a).has_value());
+        REQUIRE(s.compile().has_value());
+
+        REQUIRE(s.run().has_value());
+        REQUIRE(calls == 1);
+
+        should_stop = false;
+        REQUIRE(s.run().has_value());
+        REQUIRE(calls == 3);
+    }
+
+    GIVEN("A graph with a speculative branch") {
+        auto s = Scheduler(2);
+        std::atomic<int> calls{0};
+        std::atomic<bool> cancelled{false};
+
+        auto a = s.add_task([&calls] { ++calls; return 1; });
+        auto b = s.add_task([&calls, &cancelled](TaskToken& t) {
+            ++calls;
+            t.cancel_downstream();
+            cancelled = t.is_cancelled();
+            return 2;
+        });
+        auto c = s.add_task([&calls] { ++calls; });
+        auto d = s.add_task([&calls] { ++calls; });
+        std::atomic<int> e_value{0};
+        auto e = s.add_task([&calls, &e_value, a](TaskToken& t) {
+            ++calls;
+            e_value = t.arg(a)->ref() + 1;
+            return e_value.load();
+        });
+        REQUIRE(b.deps_on(a).has_value());
+        REQUIRE(c.deps_on(b).has_value());
+        REQUIRE(d.deps_on(c, e).has_value());
+        REQUIRE(e.deps_on(a).has_value());
+
+        WHEN("The branch cancels its successors") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(cancelled);
+            REQUIRE(calls == 3);
+            REQUIRE(e_value == 2);
+            // Its only consumer is cancelled, so the value is freed.
+            REQUIRE(s.get_result(e).error() == ValueStoreError::not_found);
+            REQUIRE(s.get_result(b).error() == ValueStoreError::not_found);
+        }
+
+        WHEN("The deadline has already passed") {
+            auto res = s.run(std::chrono::steady_clock::now());
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == SchedulerError::deadline_exceeded);
+            REQUIRE(calls == 0);
+        }
+    }
+
+    GIVEN("A task cancelling another branch") {
+        auto s = Scheduler(2);
+        std::atomic<int> calls{0};
+        Scheduler::DependencyTracker branch{};
+        auto a = s.add_task([&s, &calls, &branch] { ++calls; s.cancel(branch); });
+        auto b = s.add_task([&calls] { ++calls; });
+        auto c = s.add_task([&calls] { ++calls; });
+        branch = b;
+        REQUIRE(b.deps_on(a).has_value());
+        REQUIRE(c.deps_on(b).has_value());
+        REQUIRE(s.compile().has_value());
+
+        for (auto i = 1; i <= 3; ++i) {
+            REQUIRE(s.run().has_value());
+            REQUIRE(calls == i);
+        }
+    }
+
+    GIVEN("A consumer cancelled while its second producer is running") {
+        auto s = Scheduler(2);
+        Scheduler::DependencyTracker consumer{};
+        auto a = s.add_task([] { return 1; });
+        auto b = s.add_task([&s, &consumer, a](TaskToken& t) {
+            s.cancel(consumer);
+            return t.arg(a)->ref() + 1;
+        });
+        auto c = s.add_task([a, b](TaskToken& t) { return t.arg(a)->ref() + t.arg(b)->ref(); });
+        consumer = c;
+        REQUIRE(b.deps_on(a).has_value());
+        REQUIRE(c.deps_on(a, b).has_value());
+        REQUIRE(s.compile().has_value());
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            // Both values lost their last reader; `b` only after it was published.
+            REQUIRE(s.get_result(a).error() == ValueStoreError::not_found);
+            REQUIRE(s.get_result(b).error() == ValueStoreError::not_found);
+            REQUIRE(s.get_result(c).error() == ValueStoreError::not_found);
+        }
+    }
+
+    GIVEN("A graph with a cycle") {
+        auto s = Scheduler(1);
+        auto a = s.add_task([] {});
+        auto b = s.add_task([] {});
+        auto c = s.add_task([] {});
+        auto d = s.add_task([] {});
+        auto e = s.add_task([] {});
+        auto edges = std::array {
+            std::pair{ a, b },
+            std::pair{ b, c },
+            std::pair{ c, d },
+            std::pair{ d, b },
+            std::pair{ d, e },
+        };
+        REQUIRE(s.add_edges(edges).has_value());
+
+        auto res = s.run();
+        REQUIRE(!res.has_value());
+        REQUIRE(res.error() == SchedulerError::cycle_found);
+
+        auto cycle = s.cycle();
+        REQUIRE(cycle.size() == 3);
+        REQUIRE(cycle[0] == b.id);
+        REQUIRE(cycle[1] == c.id);
+        REQUIRE(cycle[2] == d.id);
+        REQUIRE(!s.compile().has_value());
+    }
+
+    GIVEN("A graph with duplicated edges") {
+        auto s = Scheduler(1);
+        std::atomic<int> calls{0};
+        auto a = s.add_task([&calls] { ++calls; return 1; });
+        auto b = s.add_task([&calls](TaskToken& t) { ++calls; return t.all_of<int>().size(); });
+        REQUIRE(b.deps_on(a, a, a).has_value());
+        REQUIRE(s.add_edge(a, b).has_value());
+        REQUIRE(s.run().has_value());
+        REQUIRE(calls == 2);
+        REQUIRE(s.get_result<std::size_t>(b) == 1);
+    }
+
+    GIVEN("Ready tasks with different priorities") {
+        using priority_t = Task::priority_t;
+        auto s = Scheduler(1);
+        std::vector<priority_t> order;
+        constexpr auto priorities = std::array{
+            priority_t::idle, priority_t::normal, priority_t::highest,
+            priority_t::idle, priority_t::normal, priority_t::highest,
+        };
+        for (auto p: priorities) {
+            s.add_task([&order, p] { order.push_back(p); }, p);
+        }
+        REQUIRE(s.run().has_value());
+        REQUIRE(!s.os_priority());
+        REQUIRE(order.size() == priorities.size());
+        REQUIRE(order[0] == priority_t::highest);
+        REQUIRE(order[1] == priority_t::highest);
+        REQUIRE(order[2] == priority_t::normal);
+        REQUIRE(order[3] == priority_t::normal);
+        REQUIRE(order[4] == priority_t::idle);
+        REQUIRE(order[5] == priority_t::idle);
+    }
+
+    GIVEN("A long chain next to independent tasks") {
+        auto make_graph = [](Scheduler& s, std::vector<int>& order) {
+            for (auto i = 0; i < 4; ++i) {
+                s.add_task([&order, i] { order.push_back(i); });
+            }
+            auto prev = s.add_task([&order] { order.push_back(4); });
+            for (auto i = 5; i < 8; ++i) {
+                auto next = s.add_task([&order, i] { order.push_back(i); });
+                REQUIRE(next.deps_on(prev).has_value());
+                prev = next;
+            }
+        };
+
+        auto s = Scheduler(1);
+        std::vector<int> order;
+        make_graph(s, order);
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(order.size() == 8);
+            REQUIRE(order[0] == 4);
+        }
+
+        WHEN("The profile is saved and loaded") {
+            REQUIRE(s.compile().has_value());
+            REQUIRE(s.run().has_value());
+            auto profile = std::stringstream();
+            s.save_profile(profile);
+
+            auto other = Scheduler(1);
+            std::vector<int> other_order;
+            make_graph(other, other_order);
+            REQUIRE(other.load_profile(profile).has_value());
+            REQUIRE(other.run().has_value());
+            // The whole chain runs before any of the independent tasks.
+            REQUIRE(other_order.size() == 8);
+            REQUIRE(std::vector(other_order.begin(), other_order.begin() + 4) == std::vector<int>{ 4, 5, 6, 7 });
+
+            auto changed = Scheduler(1);
+            make_graph(changed, other_order);
+            changed.add_task([] {});
+            profile.clear();
+            profile.seekg(0);
+            auto res = changed.load_profile(profile);
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == SchedulerError::invalid_profile);
+        }
+
+        WHEN("A profile with another fingerprint is loaded") {
+            REQUIRE(s.compile().has_value());
+            REQUIRE(s.run().has_value());
+            auto profile = std::stringstream();
+            s.save_profile(profile);
+            std::string magic;
+            int version{};
+            std::uint64_t hash{};
+            REQUIRE(profile >> magic >> version >> hash);
+            auto tampered = std::stringstream();
+            tampered << magic << ' ' << version << ' ' << hash + 1 << profile.rdbuf();
+
+            auto other = Scheduler(1);
+            std::vector<int> other_order;
+            make_graph(other, other_order);
+            auto res = other.load_profile(tampered);
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == SchedulerError::invalid_profile);
+        }
+    }
+
+    GIVEN("A compiled graph whose run times were not measured yet") {
+        auto s = Scheduler(1);
+        std::vector<int> order;
+        s.add_task([&order] { order.push_back(0); });
+        s.add_task([&order] {
+            order.push_back(1);
+            auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+            while (std::chrono::steady_clock::now() < end);
+        });
+        REQUIRE(s.compile().has_value());
+
+        WHEN("It is run again") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(order == std::vector<int>{ 0, 1 });
+            order.clear();
+            // The measured run times drifted away from the plan so it is ranked again.
+            REQUIRE(s.run().has_value());
+            REQUIRE(order == std::vector<int>{ 1, 0 });
+            REQUIRE(s.is_compiled());
+        }
+    }
+
+    GIVEN("Short chains behind more than a tree of independent tasks") {
+        constexpr auto chains = 16;
+        constexpr auto side = 192;
+        auto s = Scheduler(4);
+        auto picks = std::atomic<int>{0};
+        auto heads = std::array<std::atomic<int>, chains>{};
+        // Keeps every worker busy long enough to come back to the trees each time.
+        auto spin = [] {
+            auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+            while (std::chrono::steady_clock::now() < end);
+        };
+        for (auto i = 0; i < side; ++i) {
+            s.add_task([&picks, spin] { picks.fetch_add(1); spin(); });
+        }
+        for (auto c = 0; c < chains; ++c) {
+            auto prev = s.add_task([&picks, &heads, spin, c] { heads[c].store(picks.fetch_add(1)); spin(); });
+            for (auto k = 1; k < 4; ++k) {
+                auto next = s.add_task([] {});
+                REQUIRE(next.deps_on(prev).has_value());
+                prev = next;
+            }
+        }
+        REQUIRE(s.compile().has_value());
+
+        WHEN("It is run by several workers") {
+            REQUIRE(s.run().has_value());
+            // Every worker scans the trees in rank order, so the heads of the chains
+            // are picked before the independent tasks; a worker may be a pick late.
+            for (auto const& h: heads) REQUIRE(h.load() < chains + 4);
+        }
+    }
+
+    GIVEN("Workers that never park") {
+        auto s = Scheduler(2, IdlePolicy::busy_poll());
+        std::atomic<int> calls{0};
+        auto a = s.add_task([&calls] { ++calls; return 2; });
+        auto b = s.add_task([&calls, a](TaskToken& t) {
+            ++calls;
+            return t.arg<int>(a.id)->ref() * 3;
+        });
+        REQUIRE(b.deps_on(a).has_value());
+        REQUIRE(s.compile().has_value());
+        for (auto i = 1; i <= 5; ++i) {
+            REQUIRE(s.run().has_value());
+            REQUIRE(calls == 2 * i);
+            REQUIRE(s.get_result<int>(b) == 6);
+        }
+    }
+
+    GIVEN("Schedulers sharing a worker pool") {
+        auto pool = WorkerPool(2);
+        REQUIRE(pool.spawned() == 0);
+
+        auto make_chain = [](Scheduler& s, std::atomic<int>& calls) {
+            auto prev = s.add_task([&calls] { ++calls; return 1; });
+            for (auto i = 0; i < 16; ++i) {
+                auto next = s.add_task([&calls, id = prev.id](TaskToken& t) {
+                    ++calls;
+                    return t.arg<int>(id)->take() + 1;
+                });
+                REQUIRE(next.deps_on(prev).has_value());
+                prev = next;
+            }
+            return prev;
+        };
+
+        auto s1 = Scheduler(pool);
+        auto s2 = Scheduler(pool);
+        std::atomic<int> calls1{0};
+        std::atomic<int> calls2{0};
+        auto last1 = make_chain(s1, calls1);
+        auto last2 = make_chain(s2, calls2);
+        REQUIRE(s1.compile().has_value());
+        REQUIRE(s2.compile().has_value());
+
+        for (auto i = 1; i <= 5; ++i) {
+            std::expected<void, SchedulerError> r1, r2;
+            auto t1 = std::thread([&] { r1 = s1.run(); });
+            auto t2 = std::thread([&] { r2 = s2.run(); });
+            t1.join();
+            t2.join();
+            REQUIRE(r1.has_value());
+            REQUIRE(r2.has_value());
+            REQUIRE(calls1 == 17 * i);
+            REQUIRE(calls2 == 17 * i);
+            REQUIRE(s1.get_result<int>(last1) == 17);
+            REQUIRE(s2.get_result<int>(last2) == 17);
+        }
+        REQUIRE(pool.spawned() >= 1);
+        REQUIRE(pool.spawned() <= pool.size());
+    }
+
+    GIVEN("A scheduler config") {
+        auto cpus = internal::parse_cpu_list("0-2,5");
+        REQUIRE(cpus.has_value());
+        REQUIRE(*cpus == std::vector<bool>{ true, true, true, false, false, true });
+        REQUIRE(!internal::parse_cpu_list("3-1").has_value());
+        REQUIRE(!internal::parse_cpu_list("a").has_value());
+
+        auto s = Scheduler(SchedulerConfig{
+            .nthreads = 2,
+            .affinity = { std::vector<bool>{ true } },
+            .name_prefix = "tpl-test-",
+            .stack_size = 1 << 20,
+            .use_env = false
+        });
+        std::optional<std::string> name;
+        std::size_t stack_size{};
+        auto a = s.add_task([&] {
+            name = ThisThread::get_name();
+            stack_size = ThisThread::stack_size();
+        });
+        (void)a;
+        REQUIRE(s.run().has_value());
+        #if defined(__linux__)
+        REQUIRE(name.has_value());
+        REQUIRE(name->starts_with("tpl-test-"));
+        REQUIRE(stack_size >= (1 << 20));
+        #endif
+    }
+
+    GIVEN("A task reading its inputs by position") {
+        auto s = Scheduler(2);
+        auto a = s.add_task([] { return 1; });
+        auto b = s.add_task([] { return 2; });
+        auto c = s.add_task([] { return std::string("skip"); });
+        auto d = s.add_task([] { return 3; });
+        std::size_t count{};
+        int sum{};
+        int first{};
+        bool mismatch{};
+        bool out_of_range{};
+        bool consumed{};
+        std::size_t left{};
+        auto e = s.add_task([&](TaskToken& t) {
+            auto args = t.all_of<int>();
+            count = args.size();
+            first = t.arg_at<int>(1)->ref();
+            mismatch = t.arg_at<int>(2).error() == TaskError::type_mismatch;
+            out_of_range = !t.arg_at<int>(4).has_value();
+            // `e` is the only consumer, so the inputs are moved into it.
+            consumed = !t.arg_at<int>(1).has_value();
+            for (auto v: args) sum += v.ref();
+            // The inputs it moved out are skipped by a second pass.
+            left = args.size();
+        });
+        REQUIRE(e.deps_on(b, a, c, d).has_value());
+        REQUIRE(s.run().has_value());
+        REQUIRE(first == 1);
+        REQUIRE(mismatch);
+        REQUIRE(out_of_range);
+        REQUIRE(consumed);
+        REQUIRE(count == 3);
+        REQUIRE(sum == 5);
+        REQUIRE(left == 0);
+    }
+
+    GIVEN("Typed trackers") {
+        struct Point { int x; int y; };
+        auto s = Scheduler(2);
+        auto a = s.add_task([] { return Point{ 1, 2 }; });
+        auto b = s.add_task([] { return std::string("tpl"); });
+        static_assert(std::same_as<decltype(a), Scheduler::TypedTracker<Point>>);
+        static_assert(std::same_as<decltype(b), Scheduler::TypedTracker<std::string>>);
+        static_assert(internal::is_inline_value_v<Point>);
+        static_assert(!internal::is_inline_value_v<std::string>);
+
+        auto c = s.add_task([a, b](TaskToken& t) {
+            auto p = t.arg(a);
+            auto str = t.arg(b);
+            if (!p || !str) return std::size_t{};
+            return static_cast<std::size_t>(p->ref().x + p->ref().y) + str->ref().size();
+        });
+        REQUIRE(c.deps_on(a, b).has_value());
+        // `a` has finished but it's not an input.
+        auto rejected = std::atomic<bool>{false};
+        auto d = s.add_task([a, c, &rejected](TaskToken& t) {
+            rejected = t.arg(a).error() == TaskError::invalid_task_id;
+            return t.arg(c)->ref();
+        });
+        REQUIRE(d.deps_on(c).has_value());
+        REQUIRE(s.run().has_value());
+        REQUIRE(s.get_result(d) == 6);
+        REQUIRE(s.get_result<std::size_t>(d.id).error() == ValueStoreError::not_found);
+        REQUIRE(rejected);
+    }
+
+    GIVEN("A task with output ports") {
+        auto s = Scheduler(2);
+        auto parse = s.add_task([] {
+            return Ports{ std::string("header"), std::vector<int>{ 1, 2, 3 } };
+        });
+        auto header = parse.port<0>();
+        auto body = parse.port<1>();
+        static_assert(std::same_as<decltype(body), Scheduler::PortTracker<std::vector<int>>>);
+
+        bool moved{};
+        auto size = s.add_task([body, &moved](TaskToken& t) {
+            auto v = t.arg(body);
+            if (!v) return std::size_t{};
+            moved = v->is_borrowed();
+            return v->take().size();
+        });
+        auto length = s.add_task([header](TaskToken& t) {
+            auto h = t.view(header);
+            return h ? h->get().size() : 0ul;
+        });
+        auto title = s.add_task([header](TaskToken& t) {
+            auto h = t.view(header);
+            return h ? h->get() + "!" : std::string();
+        });
+        REQUIRE(size.deps_on(body).has_value());
+        REQUIRE(length.deps_on(header).has_value());
+        REQUIRE(title.deps_on(header).has_value());
+        REQUIRE(s.run().has_value());
+
+        // The body had a single consumer, so it was moved out of its port.
+        REQUIRE(moved);
+        REQUIRE(s.get_result(size) == 3);
+        REQUIRE(s.get_result(length) == 6);
+        REQUIRE(s.get_result(title) == "header!");
+        // The header was shared and freed by its last consumer.
+        REQUIRE(s.get_result(header).error() == ValueStoreError::not_found);
+        REQUIRE(s.get_result(parse).error() == ValueStoreError::not_found);
+    }
+
+    GIVEN("A large result shared by several consumers") {
+        constexpr auto consumers = 16ul;
+        auto s = Scheduler(4);
+        auto a = s.add_task([] { return std::vector<int>(1 << 16, 1); });
+        std::array<std::size_t, consumers> sums{};
+        auto sink = s.add_task([](TaskToken& t) { return t.inputs().size(); });
+        for (auto i = 0ul; i < consumers; ++i) {
+            auto c = s.add_task([a, &sums, i](TaskToken& t) {
+                auto v = t.view(a);
+                if (!v) return;
+                for (auto x: v->get()) sums[i] += static_cast<std::size_t>(x);
+            });
+            REQUIRE(c.deps_on(a).has_value());
+            REQUIRE(sink.deps_on(c).has_value());
+        }
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            for (auto sum: sums) REQUIRE(sum == (1 << 16));
+            // The last consumer freed it; only the sink's result is left.
+            REQUIRE(s.get_result(a).error() == ValueStoreError::not_found);
+            REQUIRE(s.get_result(sink) == consumers);
+        }
+
+        WHEN("It is compiled and run many times") {
+            REQUIRE(s.compile().has_value());
+            for (auto i = 0; i < 3; ++i) {
+                sums.fill(0);
+                REQUIRE(s.run().has_value());
+                for (auto sum: sums) REQUIRE(sum == (1 << 16));
+                REQUIRE(s.get_result(a).error() == ValueStoreError::not_found);
+            }
+        }
+    }
+
+    GIVEN("A task polling with a delay") {
+        using namespace std::chrono_literals;
+        auto s = Scheduler(2);
+        auto polls = std::atomic<int>{0};
+        auto work = std::atomic<bool>{false};
+        auto start = std::chrono::steady_clock::now();
+
+        auto poll = s.add_task([&polls](TaskToken& t) {
+            if (polls.fetch_add(1) + 1 < 5) t.schedule_after(2ms);
+            return 1;
+        });
+        auto next = s.add_task([poll](TaskToken& t) { return t.arg<int>(poll.id)->ref() + 1; });
+        REQUIRE(next.deps_on(poll).has_value());
+        s.queue_work_after(5ms, [&work] noexcept { work.store(true); });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            // `run` waits for the delayed task and the delayed work.
+            REQUIRE(polls.load() == 5);
+            REQUIRE(work.load());
+            REQUIRE(std::chrono::steady_clock::now() - start >= 8ms);
+            REQUIRE(s.get_result(next) == 2);
+        }
+    }
+
+    GIVEN("A task sleeping past the deadline") {
+        using namespace std::chrono_literals;
+        auto s = Scheduler(2);
+        auto polls = std::atomic<int>{0};
+        auto calls = std::atomic<int>{0};
+
+        auto sleeper = s.add_task([&polls](TaskToken& t) {
+            if (polls.fetch_add(1) == 0) t.schedule_after(10s);
+            return 1;
+        });
+        auto next = s.add_task([&calls] { ++calls; });
+        REQUIRE(next.deps_on(sleeper).has_value());
+        REQUIRE(s.compile().has_value());
+
+        WHEN("It is run with a deadline") {
+            auto start = std::chrono::steady_clock::now();
+            auto res = s.run_for(20ms);
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == SchedulerError::deadline_exceeded);
+            // `run` doesn't wait for the timer of the cancelled task.
+            REQUIRE(std::chrono::steady_clock::now() - start < 5s);
+            REQUIRE(polls.load() == 1);
+            REQUIRE(calls.load() == 0);
+
+            // The timer of the first run is ignored when it fires.
+            REQUIRE(s.run().has_value());
+            REQUIRE(polls.load() == 2);
+            REQUIRE(calls.load() == 1);
+        }
+    }
+
+    GIVEN("Tasks awaiting queued work on a single worker") {
+        auto s = Scheduler(1);
+        auto sum = s.add_task([](TaskToken& t) {
+            auto total = 0;
+            for (auto i = 1; i <= 64; ++i) {
+                // The worker runs the work itself instead of blocking on it.
+                total += t.awaitable_queue_work([i] noexcept { return i; }).await();
+            }
+            return total;
+        });
+        auto nested = s.add_task([](TaskToken& t) {
+            return t.awaitable_queue_work([&t] noexcept {
+                return t.awaitable_queue_work([] noexcept { return 20; }).await() + 1;
+            }).await() * 2;
+        });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(s.get_result(sum) == 64 * 65 / 2);
+            REQUIRE(s.get_result(nested) == 42);
+        }
+
+        WHEN("It is awaited from outside the pool") {
+            s.add_task([] { return 1; });
+            auto v = s.awaitable_queue_work([] noexcept { return 7; });
+            REQUIRE(s.run().has_value());
+            REQUIRE(v.await() == 7);
+        }
+    }
+
+    GIVEN("Work submitted in bulk") {
+        constexpr auto n = 1000ul;
+        auto s = Scheduler(4);
+        auto calls = std::atomic<std::size_t>{0};
+        auto sum = std::atomic<std::size_t>{0};
+        auto bulk = [&calls] noexcept { calls.fetch_add(1); };
+
+        s.queue_work_bulk(std::vector(n, bulk));
+        // Move-only callables are moved out of an rvalue range.
+        auto owned_sum = std::atomic<int>{0};
+        auto make_owned = [&owned_sum](int v) {
+            return [&owned_sum, p = std::make_unique<int>(v)] mutable noexcept {
+                owned_sum.fetch_add(*p);
+                p.reset();
+            };
+        };
+        auto owned = std::vector<decltype(make_owned(0))>();
+        owned.push_back(make_owned(1));
+        owned.push_back(make_owned(2));
+        s.queue_work_bulk(std::move(owned));
+        // Every variant invokes a callable whose call operator is not const.
+        auto delayed = std::atomic<int>{0};
+        s.queue_work_after(std::chrono::milliseconds(1), [&delayed, i = 0] mutable noexcept { delayed.store(++i); });
+        auto awaited = s.awaitable_queue_work([i = 41] mutable noexcept { return ++i; });
+        s.submit_n(n, [&sum](std::size_t i) noexcept { sum.fetch_add(i); });
+        // More items than a worker's deque holds.
+        s.add_task([&sum](TaskToken& t) {
+            t.submit_n(n, [&sum](std::size_t i) noexcept { sum.fetch_add(i); });
+        });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(calls.load() == n);
+            REQUIRE(owned_sum.load() == 3);
+            REQUIRE(delayed.load() == 1);
+            REQUIRE(awaited.await() == 42);
+            REQUIRE(sum.load() == n * (n - 1));
+        }
+    }
+
+    GIVEN("Awaiters composed with continuations") {
+        auto s = Scheduler(2);
+        auto all = std::atomic<int>{0};
+        auto any = std::atomic<int>{-1};
+        s.add_task([&all, &any](TaskToken& t) {
+            auto a = t.awaitable_queue_work([] noexcept { return std::string("4"); })
+                .then([](std::string&& v) noexcept { return std::stoi(v + "0"); });
+            auto b = t.awaitable_queue_work([] noexcept { return 2; });
+            auto c = t.awaitable_queue_work([] noexcept {});
+            // Nobody waits on the results; the last continuation stores them.
+            (void)when_all(std::move(a), std::move(b), std::move(c))
+                .then([&all](std::tuple<int, int, void*>&& v) noexcept {
+                    all.store(std::get<0>(v) + std::get<1>(v));
+                });
+            (void)when_any(t.awaitable_queue_work([] noexcept { return 1; }))
+                .then([&any](std::variant<int>&& v) noexcept {
+                    any.store(static_cast<int>(v.index()) + std::get<0>(v));
+                });
+        });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            REQUIRE(all.load() == 42);
+            REQUIRE(any.load() == 1);
+        }
+    }
+
+    GIVEN("An awaiter with a single waiter") {
+        // A copy would be a second waiter on the same state.
+        static_assert(!std::is_copy_constructible_v<Awaiter<int>>);
+        static_assert(!std::is_copy_assignable_v<Awaiter<int>>);
+        static_assert(!joinable_twice<Awaiter<int>>);
+
+        auto state = internal::AwaiterRef<int>{};
+        auto first = 0;
+        auto second = 0;
+        auto f1 = InplaceFunction<void()>([&first] noexcept { ++first; });
+        auto f2 = InplaceFunction<void()>([&second] noexcept { ++second; });
+
+        WHEN("Another waiter tries to park on it") {
+            REQUIRE(state->try_park(f1));
+            REQUIRE(!state->try_park(f2));
+            // The second continuation is handed back untouched.
+            f2();
+            REQUIRE(second == 1);
+
+            state->notify_value(7);
+            REQUIRE(first == 1);
+            REQUIRE(state->take() == 7);
+        }
+    }
+
+    GIVEN("Tasks and queued work counted by the workers") {
+        constexpr auto n = 64ul;
+        auto s = Scheduler(2);
+        auto runs = std::atomic<std::size_t>{0};
+        auto work = std::atomic<std::size_t>{0};
+        auto rescheduled = std::array<std::atomic<bool>, n>{};
+        for (auto i = 0ul; i < n; ++i) {
+            s.add_task([&runs, &work, &rescheduled, i](TaskToken& t) {
+                runs.fetch_add(1);
+                // Every other task runs twice and queues work from its second run.
+                if (i % 2 == 0) return 1;
+                if (!rescheduled[i].exchange(true)) {
+                    t.schedule();
+                    return 1;
+                }
+                t.queue_work([&work] noexcept { work.fetch_add(1); });
+                return 1;
+            });
+        }
+        s.submit_n(n, [&work](std::size_t) noexcept { work.fetch_add(1); });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            auto stats = s.stats();
+            REQUIRE(stats.workers.size() == 2);
+            REQUIRE(stats.total.tasks == runs.load());
+            REQUIRE(stats.total.work == work.load());
+            REQUIRE(stats.total.busy.count() > 0);
+            REQUIRE(stats.total.wakeups >= stats.total.parks);
+
+            auto sum = WorkerStats{};
+            for (auto const& w: stats.workers) sum += w;
+            REQUIRE(sum.tasks == stats.total.tasks);
+            REQUIRE(sum.work == stats.total.work);
+            REQUIRE(sum.failed_pops == stats.total.failed_pops);
+            REQUIRE(sum.select_retries == stats.total.select_retries);
+            REQUIRE(sum.parks == stats.total.parks);
+            REQUIRE(sum.wakeups == stats.total.wakeups);
+            REQUIRE(sum.busy == stats.total.busy);
+            REQUIRE(sum.idle == stats.total.idle);
+
+            s.reset_stats();
+            stats = s.stats();
+            for (auto const& w: stats.workers) {
+                REQUIRE(w.tasks == 0);
+                REQUIRE(w.work == 0);
+                REQUIRE(w.failed_pops == 0);
+                REQUIRE(w.select_retries == 0);
+                REQUIRE(w.parks == 0);
+                REQUIRE(w.wakeups == 0);
+                REQUIRE(w.busy.count() == 0);
+                REQUIRE(w.idle.count() == 0);
+            }
+            REQUIRE(stats.total.tasks == 0);
+            REQUIRE(stats.total.work == 0);
+            REQUIRE(stats.total.busy.count() == 0);
+            REQUIRE(stats.total.idle.count() == 0);
+        }
+    }
+
+#ifdef __linux__
+    GIVEN("A task reading a non-blocking pipe") {
+        using namespace std::chrono_literals;
+        int fds[2];
+        REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+        auto s = Scheduler(2);
+        auto waits = std::atomic<int>{0};
+
+        auto reader = s.add_task([fd = fds[0], &waits](TaskToken& t) {
+            char c{};
+            if (::read(fd, &c, 1) == 1) return static_cast<int>(c);
+            waits.fetch_add(1);
+            (void)t.wait_readable(fd);
+            return 0;
+        });
+        s.queue_work_after(5ms, [fd = fds[1]] noexcept {
+            char c = 42;
+            (void)!::write(fd, &c, 1);
+        });
+
+        WHEN("It is run") {
+            REQUIRE(s.run().has_value());
+            // It was parked on the reactor instead of spinning on the worker.
+            REQUIRE(waits.load() == 1);
+            REQUIRE(s.get_result(reader) == 42);
+        }
+
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    GIVEN("A task waiting on a pipe past the deadline") {
+        using namespace std::chrono_literals;
+        int fds[2];
+        REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+        auto s = Scheduler(2);
+        auto waits = std::atomic<int>{0};
+
+        auto reader = s.add_task([fd = fds[0], &waits](TaskToken& t) {
+            char c{};
+            if (::read(fd, &c, 1) == 1) return static_cast<int>(c);
+            waits.fetch_add(1);
+            (void)t.wait_readable(fd);
+            return 0;
+        });
+        REQUIRE(s.compile().has_value());
+
+        WHEN("Nothing is written before the deadline") {
+            auto res = s.run_for(20ms);
+            REQUIRE(!res.has_value());
+            REQUIRE(res.error() == SchedulerError::deadline_exceeded);
+            REQUIRE(waits.load() == 1);
+
+            // The descriptor was released, so the next run can wait on it again.
+            s.queue_work_after(5ms, [fd = fds[1]] noexcept {
+                char c = 42;
+                (void)!::write(fd, &c, 1);
+            });
+            REQUIRE(s.run().has_value());
+            REQUIRE(waits.load() == 2);
+            REQUIRE(s.get_result(reader) == 42);
+        }
+
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+#endif
+}
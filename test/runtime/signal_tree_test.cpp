@@ -60,4 +60,35 @@ TEST_CASE("Signal Tree", "[signal_tree]" ) {
             REQUIRE(tree.empty());
         }
     }
+
+    GIVEN("A full sized tree") {
+        auto tree = SignalTree<128ul>{};
+
+        WHEN("Every leaf is set") {
+            for (auto i = 0ul; i < tree.capacity; ++i) tree.set(i);
+            REQUIRE(tree.get_level<0>().get_value({0}) == tree.capacity);
+
+            for (auto i = 0ul; i < tree.capacity; ++i) {
+                auto [idx, _] = tree.select();
+                INFO(std::format("Tree[{}]", i));
+                REQUIRE(!idx.is_invalid());
+                REQUIRE(idx.index == i);
+            }
+            REQUIRE(tree.empty());
+        }
+
+        WHEN("Leaves are selected with a hint") {
+            for (auto i = 0ul; i < tree.capacity; ++i) tree.set(i);
+            std::size_t retries{};
+            // The hint only reorders a group of four neighbouring leaves.
+            for (auto i = 0ul; i < tree.capacity; ++i) {
+                auto [idx, _] = tree.select(retries, 3);
+                INFO(std::format("Tree[{}]", i));
+                REQUIRE(!idx.is_invalid());
+                REQUIRE(idx.index == (i & ~3ul) + 3 - (i & 3));
+            }
+            REQUIRE(retries == 0);
+            REQUIRE(tree.empty());
+        }
+    }
 }
@@ -0,0 +1,93 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "tpl/timer_wheel.hpp"
+
+using namespace tpl;
+using namespace std::chrono_literals;
+
+TEST_CASE("Timer Wheel", "[timer_wheel]" ) {
+    using clock = TimerWheel::clock;
+
+    WHEN("An empty wheel is constructed") {
+        auto w = TimerWheel{};
+        REQUIRE(w.pending() == 0);
+    }
+
+    GIVEN("Timers with different delays") {
+        constexpr auto n = 256ul;
+        auto w = TimerWheel{};
+        auto fired = std::vector<std::atomic<bool>>(n);
+        auto early = std::atomic<std::size_t>{0};
+        auto count = std::atomic<std::size_t>{0};
+
+        WHEN("They are added from one thread") {
+            auto now = clock::now();
+            for (auto i = 0ul; i < n; ++i) {
+                // Spread over several levels of the wheel: microseconds up to ~100ms.
+                auto tp = now + std::chrono::microseconds((i * 7919) % 100'000);
+                w.schedule_at(tp, [&, tp, i] noexcept {
+                    if (clock::now() < tp) early.fetch_add(1);
+                    fired[i].store(true);
+                    count.fetch_add(1);
+                });
+            }
+            while (w.pending() != 0) std::this_thread::sleep_for(1ms);
+
+            REQUIRE(count.load() == n);
+            REQUIRE(early.load() == 0);
+            for (auto const& f: fired) REQUIRE(f.load());
+        }
+
+        WHEN("They are added from several threads") {
+            auto threads = std::vector<std::thread>{};
+            for (auto t = 0ul; t < 4; ++t) {
+                threads.emplace_back([&, t] {
+                    for (auto i = t; i < n; i += 4) {
+                        w.schedule_after(std::chrono::microseconds(i * 100), [&, i] noexcept {
+                            fired[i].store(true);
+                            count.fetch_add(1);
+                        });
+                    }
+                });
+            }
+            for (auto& t: threads) t.join();
+            while (w.pending() != 0) std::this_thread::sleep_for(1ms);
+
+            REQUIRE(count.load() == n);
+            for (auto const& f: fired) REQUIRE(f.load());
+        }
+    }
+
+    WHEN("A timer is added while the wheel waits for a later one") {
+        auto w = TimerWheel{};
+        auto late = std::atomic<bool>{false};
+        w.schedule_after(1s, [&] noexcept { late.store(true); });
+        std::this_thread::sleep_for(5ms);
+
+        auto start = clock::now();
+        auto done = std::atomic<bool>{false};
+        w.schedule_after(2ms, [&] noexcept { done.store(true); });
+        while (!done.load()) std::this_thread::sleep_for(100us);
+
+        // The timer thread was woken up instead of sleeping for the full second.
+        REQUIRE(clock::now() - start < 500ms);
+        REQUIRE(!late.load());
+        REQUIRE(w.pending() == 1);
+    }
+
+    WHEN("The wheel is destroyed with pending timers") {
+        auto called = std::atomic<bool>{false};
+        {
+            auto w = TimerWheel{};
+            w.schedule_after(10s, [&] noexcept { called.store(true); });
+            REQUIRE(w.pending() == 1);
+        }
+        REQUIRE(!called.load());
+    }
+}
@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+
+#define TPL_ENABLE_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include "tpl/scheduler.hpp"
+
+using namespace tpl;
+using namespace std::chrono_literals;
+
+namespace {
+    auto count(std::string const& s, std::string_view what) -> std::size_t {
+        auto n = std::size_t{};
+        for (auto pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + what.size())) ++n;
+        return n;
+    }
+} // namespace
+
+TEST_CASE("Trace Export", "[trace]" ) {
+    GIVEN("A graph with a rescheduled task and queued work") {
+        auto s = Scheduler(2);
+        auto polls = std::atomic<int>{0};
+        auto a = s.add_task([&polls](TaskToken& t) {
+            if (polls.fetch_add(1) == 0) t.schedule_after(1ms);
+            return 1;
+        });
+        auto b = s.add_task([a](TaskToken& t) { return t.arg<int>(a.id)->ref() + 1; });
+        REQUIRE(b.deps_on(a).has_value());
+        s.queue_work([] noexcept {});
+        REQUIRE(s.run().has_value());
+
+        WHEN("The trace is dumped") {
+            auto os = std::ostringstream{};
+            s.dump_trace(os);
+            auto json = os.str();
+
+            REQUIRE(json.starts_with("{\"traceEvents\":["));
+            REQUIRE(json.ends_with("]}\n"));
+            REQUIRE(count(json, "\"thread_name\"") == 2);
+            REQUIRE(count(json, "\"name\":\"task\"") == 2);
+            REQUIRE(count(json, "\"name\":\"work\"") == 1);
+            auto id = std::format("\"args\":{{\"id\":{}}}", static_cast<std::uint32_t>(a.id));
+            REQUIRE(count(json, "\"name\":\"rescheduled\"") == 1);
+            REQUIRE(count(json, id) == 2);
+        }
+
+        WHEN("The trace is cleared") {
+            s.clear_trace();
+            auto os = std::ostringstream{};
+            s.dump_trace(os);
+            REQUIRE(count(os.str(), "\"ph\":\"X\"") == 0);
+        }
+    }
+}
@@ -1,6 +1,9 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <print>
+#include <string>
+#include <thread>
+#include <vector>
 #include "tpl/task_id.hpp"
 #include "tpl/value_store.hpp"
 
@@ -52,5 +55,128 @@ TEST_CASE("Value Store", "[value_store]" ) {
             store.clear();
             REQUIRE(store.size() == 0);
         }
+
+        WHEN("A value is read with its type known statically") {
+            store.put(TaskId(4), std::vector<int>{ 1, 2, 3 });
+
+            auto shared = store.get_unchecked<std::vector<int>>(TaskId(4));
+            REQUIRE(shared.has_value());
+            REQUIRE(shared->ref().size() == 3);
+
+            auto val = store.consume_unchecked<std::vector<int>>(TaskId(4));
+            REQUIRE(val.has_value());
+            REQUIRE(val->take() == std::vector<int>{ 1, 2, 3 });
+            // Only the publication is checked, so a consumed value is still not found.
+            REQUIRE(store.consume_unchecked<std::vector<int>>(TaskId(4)).error() == ValueStoreError::not_found);
+            REQUIRE(store.empty());
+        }
+
+        WHEN("Inline slots are reserved ahead of the values") {
+            struct Big { std::byte data[128]; };
+            store.reserve_inline<int>(TaskId(0));
+            store.reserve_inline<Big>(TaskId(1));
+            store.reserve_inline<int>(TaskId(7));
+
+            store.put(TaskId(0), 42);
+            store.put(TaskId(1), Big{});
+            REQUIRE(store.size() == 2);
+            REQUIRE(*store.get_inline<int>(TaskId(0)) == 42);
+            REQUIRE(store.get<Big>(TaskId(1)).has_value());
+
+            store.clear();
+            // The slot outlives the run and takes a value of another type.
+            store.put(TaskId(0), 2.5);
+            REQUIRE(*store.get_inline<double>(TaskId(0)) == 2.5);
+        }
+
+        WHEN("A small trivially copyable value is put inside the store") {
+            struct Pair { int a; double b; };
+            store.put(TaskId(3), Pair{ 1, 2.5 });
+            REQUIRE(store.size() == 1);
+
+            auto ptr = store.get_inline<Pair>(TaskId(3));
+            REQUIRE(ptr != nullptr);
+            REQUIRE(ptr->a == 1);
+            REQUIRE(store.get_inline<Pair>(TaskId(4)) == nullptr);
+
+            auto val = store.consume<Pair>(TaskId(3));
+            REQUIRE(val.has_value());
+            REQUIRE(val->ref().b == 2.5);
+            REQUIRE(store.get_inline<Pair>(TaskId(3)) == nullptr);
+            REQUIRE(store.empty());
+        }
+
+        WHEN("A value is shared by several readers") {
+            store.set_readers(TaskId(0), 2);
+            store.put(TaskId(0), std::vector<int>(4, 7));
+            REQUIRE(store.size() == 1);
+
+            auto v = store.view<std::vector<int>>(TaskId(0));
+            REQUIRE(v.has_value());
+            REQUIRE(v->get().size() == 4);
+            REQUIRE(store.view<int>(TaskId(0)).error() == ValueStoreError::type_mismatch);
+
+            store.release_reader(TaskId(0));
+            REQUIRE(store.size() == 1);
+            store.release_reader(TaskId(0));
+            REQUIRE(store.empty());
+            REQUIRE(store.view<std::vector<int>>(TaskId(0)).error() == ValueStoreError::not_found);
+
+            // The count is reloaded by `clear`.
+            store.clear();
+            store.put(TaskId(0), std::vector<int>(1, 1));
+            store.release_reader(TaskId(0));
+            REQUIRE(store.size() == 1);
+            store.release_reader(TaskId(0));
+            REQUIRE(store.empty());
+        }
+
+        WHEN("Readers give up before the value is published") {
+            store.set_readers(TaskId(0), 2);
+            store.release_reader(TaskId(0));
+            store.put(TaskId(0), std::vector<int>(4, 7));
+            REQUIRE(store.size() == 1);
+            store.release_reader(TaskId(0));
+            REQUIRE(store.empty());
+
+            store.clear();
+            store.release_reader(TaskId(0));
+            store.release_reader(TaskId(0));
+            store.put(TaskId(0), std::vector<int>(4, 7));
+            REQUIRE(store.empty());
+        }
+    }
+
+    GIVEN("Producers writing to disjoint slots") {
+        constexpr auto slots = 1024ul;
+        constexpr auto nthreads = 4ul;
+        auto store = ValueStore{new BlockAllocator()};
+        store.resize(slots);
+
+        std::vector<std::thread> threads;
+        for (auto k = 0ul; k < nthreads; ++k) {
+            threads.emplace_back([&store, k] {
+                for (auto i = k; i < slots; i += nthreads) {
+                    store.put(TaskId(i), std::to_string(i));
+                }
+            });
+        }
+        for (auto& t: threads) t.join();
+        REQUIRE(store.size() == slots);
+
+        auto ok = true;
+        for (auto i = 0ul; i < slots; ++i) {
+            auto v = store.consume<std::string>(TaskId(i));
+            // The value is lent to the consumer and only moved by `take`.
+            ok = ok && v.has_value() && v->is_borrowed() && v->take() == std::to_string(i);
+        }
+        REQUIRE(ok);
+        REQUIRE(store.empty());
+        REQUIRE(store.get<std::string>(TaskId(0)).error() == ValueStoreError::not_found);
+        REQUIRE(!store.take<std::string>(TaskId(1)).has_value());
+
+        store.put(TaskId(2), std::string("moved once"));
+        REQUIRE(store.take<std::string>(TaskId(2)) == "moved once");
+        REQUIRE(store.empty());
     }
 }
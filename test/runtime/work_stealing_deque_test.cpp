@@ -0,0 +1,102 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <print>
+#include <thread>
+#include <vector>
+
+#include "tpl/work_stealing_deque.hpp"
+
+using namespace tpl;
+
+TEST_CASE("Work Stealing Deque", "[work_stealing_deque]" ) {
+    WHEN("An empty deque is constructed") {
+        auto q = WorkStealingDeque<int, 16>{};
+        REQUIRE(q.size() == 0);
+        REQUIRE(q.empty() == true);
+        REQUIRE(!q.pop().has_value());
+        REQUIRE(!q.steal().has_value());
+    }
+
+    GIVEN("A deque of capacity 16") {
+        auto q = WorkStealingDeque<int, 16>{};
+
+        WHEN("Owner pushes and pops") {
+            for (auto i = 0; i < 16; ++i) {
+                REQUIRE(q.push(i) == true);
+            }
+            REQUIRE(q.size() == 16);
+            REQUIRE(q.push(16) == false);
+
+            for (auto i = 15; i >= 0; --i) {
+                auto item = q.pop();
+                REQUIRE(item.has_value());
+                INFO(std::format("[{}]: {} == {}", i, *item, i));
+                REQUIRE(*item == i);
+            }
+            REQUIRE(q.empty());
+        }
+
+        WHEN("Thief steals from the top") {
+            for (auto i = 0; i < 8; ++i) REQUIRE(q.push(i) == true);
+            for (auto i = 0; i < 4; ++i) {
+                auto item = q.steal();
+                REQUIRE(item.has_value());
+                REQUIRE(*item == i);
+            }
+            REQUIRE(*q.pop() == 7);
+            REQUIRE(q.size() == 3);
+        }
+
+        WHEN("The indices wrap around") {
+            for (auto i = 0; i < 100; ++i) {
+                REQUIRE(q.push(i) == true);
+                REQUIRE(q.push(i + 1) == true);
+                REQUIRE(*q.steal() == i);
+                REQUIRE(*q.pop() == i + 1);
+            }
+            REQUIRE(q.empty());
+        }
+    }
+
+    GIVEN("An owner and multiple thieves") {
+        static constexpr auto N = 20'000;
+        static constexpr auto thieves = 3;
+        auto q = WorkStealingDeque<std::uint32_t, 256>{};
+        std::vector<std::atomic<int>> seen(N);
+        std::atomic<bool> done{false};
+
+        auto thief = [&] {
+            while (!done.load() || !q.empty()) {
+                if (auto item = q.steal()) {
+                    seen[*item].fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        };
+
+        std::vector<std::thread> ts;
+        for (auto i = 0; i < thieves; ++i) ts.emplace_back(thief);
+
+        for (auto i = 0u; i < N;) {
+            if (q.push(i)) {
+                ++i;
+            } else if (auto item = q.pop()) {
+                seen[*item].fetch_add(1);
+            }
+        }
+        while (auto item = q.pop()) {
+            seen[*item].fetch_add(1);
+        }
+        done.store(true);
+        for (auto& t: ts) t.join();
+
+        for (auto i = 0ul; i < seen.size(); ++i) {
+            INFO(std::format("[{}]: {} == 1", i, seen[i].load()));
+            REQUIRE(seen[i].load() == 1);
+        }
+    }
+}